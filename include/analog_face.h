@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+//-----------------------------------------------------------------------------
+// Geometry of the analog clock face, without any display dependency.
+//
+// The dial (circle & ticks) is rendered once into an XBM bitmap, per frame
+// only the hands are drawn as lines via a callback (u8g2.drawLine() on the
+// display).
+//-----------------------------------------------------------------------------
+
+#define DIAL_RADIUS 24
+#define DIAL_SIZE (2 * DIAL_RADIUS + 1)
+#define DIAL_BYTES_PER_ROW ((DIAL_SIZE + 7) / 8)
+
+struct analog_hand {
+	int angle; // FX_ANGLE_STEPS per turn, 0 = 12 o'clock
+	int length;
+	int width; // Drawn as 2 * width + 1 parallel lines
+};
+
+struct analog_hands {
+	struct analog_hand hour;
+	struct analog_hand minute;
+	struct analog_hand second;
+};
+
+typedef void (*analog_line_cb)(void *context, int x0, int y0, int x1, int y1);
+
+// Render circle and ticks into bitmap (DIAL_BYTES_PER_ROW * DIAL_SIZE bytes, XBM layout).
+void analog_face_build_dial(uint8_t *bitmap);
+
+// Bresenham line into a dial bitmap, pixels outside are ignored.
+void analog_face_line(uint8_t *bitmap, int x0, int y0, int x1, int y1);
+
+// Hand positions for the local time now, ms = milliseconds of the current second.
+void analog_face_hands(const struct tm *now, int ms, struct analog_hands *hands);
+
+// Lines of a hand around the center cx/cy.
+void analog_face_draw_hand(int cx, int cy, const struct analog_hand *hand, analog_line_cb line, void *context);
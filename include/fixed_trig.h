@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Fixed point sine/cosine via lookup table.
+//
+// Angles are FX_ANGLE_STEPS per full turn, 0 = 12 o'clock, clockwise.
+// Results are scaled by 1 << FX_SHIFT. The quarter wave table is calculated
+// by the compiler, see fixed_trig.cpp.
+//-----------------------------------------------------------------------------
+
+#define FX_SHIFT 14
+#define FX_ONE (1 << FX_SHIFT)
+#define FX_HALF (1 << (FX_SHIFT - 1))
+
+#define FX_ANGLE_STEPS 1024
+#define FX_QUARTER (FX_ANGLE_STEPS / 4)
+
+extern const int16_t fx_sin_table[FX_QUARTER + 1];
+
+inline int fx_sin(int angle)
+{
+	angle &= FX_ANGLE_STEPS - 1;
+	if (angle < FX_QUARTER)
+		return fx_sin_table[angle];
+	if (angle < 2 * FX_QUARTER)
+		return fx_sin_table[2 * FX_QUARTER - angle];
+	if (angle < 3 * FX_QUARTER)
+		return -fx_sin_table[angle - 2 * FX_QUARTER];
+	return -fx_sin_table[FX_ANGLE_STEPS - angle];
+}
+
+inline int fx_cos(int angle)
+{
+	return fx_sin(angle + FX_QUARTER);
+}
+
+// value * fx_sin()/fx_cos() back to integer, rounded:
+inline int fx_mul(int value, int fx)
+{
+	return (value * fx + FX_HALF) >> FX_SHIFT;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// Subsets of the u8g2 fonts, generated by tools/font_subset.py.
+//
+// Only the glyphs we draw are kept, pre-decoded as XBM bitmaps (one row padded
+// to full bytes, lsb = leftmost pixel). A glyph is found via a 256 entry index
+// instead of walking the whole u8g2 font.
+//-----------------------------------------------------------------------------
+
+struct subset_glyph {
+	uint8_t width;
+	uint8_t height;
+	int8_t x_offset;
+	int8_t y_offset; // bottom of the bitmap relative to the baseline
+	int8_t advance;
+	uint16_t bitmap; // offset into subset_font.bitmaps
+};
+
+struct subset_font {
+	const uint8_t *index; // Latin-1 code -> glyph number, 0xff = not available
+	const struct subset_glyph *glyphs;
+	const uint8_t *bitmaps;
+	uint8_t max_width; // Bounding box of all glyphs of the u8g2 font
+	uint8_t max_height;
+};
+
+extern const struct subset_font font_5x8_subset;
+extern const struct subset_font font_6x10_subset;
+extern const struct subset_font font_5x7_subset;
+
+// Return the next character of an UTF-8 string and advance *text, 0 at the end.
+uint16_t utf8_next(const char **text);
+
+inline const struct subset_glyph *subset_font_glyph(const struct subset_font *font, uint16_t code)
+{
+	if (code > 0xff || font->index[code] == 0xff)
+		return NULL;
+	return &font->glyphs[font->index[code]];
+}
+
+// Draw a horizontal run of len pixels:
+typedef void (*subset_hline_cb)(void *context, int x, int y, int len);
+
+// Draw a glyph as horizontal runs, y is the baseline. Only the rows
+// clip_top <= y < clip_bottom are drawn (the current u8g2 page).
+void subset_draw_glyph(const struct subset_font *font, const struct subset_glyph *glyph, int x, int y, int clip_top, int clip_bottom, subset_hline_cb hline,
+                       void *context);
+
+#ifdef FONT_SUBSET_REFERENCE
+// Host tests only: the complete u8g2 font of each subset and the texts the
+// subset was made for (NULL terminated).
+struct subset_reference {
+	const char *u8g2_name;
+	const uint8_t *u8g2_font;
+	const struct subset_font *subset;
+	const char *const *texts;
+};
+
+extern const struct subset_reference font_subset_references[];
+extern const int font_subset_reference_count;
+#endif
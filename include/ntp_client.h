@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// SNTP (RFC 4330) client logic.
+//
+// This part knows nothing about WIFI/UDP, the transport lives in main.cpp.
+// All timestamps are microseconds since 1970-01-01, read via gettimeofday().
+//-----------------------------------------------------------------------------
+
+#define NTP_PORT 123
+#define NTP_PACKET_SIZE 48
+#define NTP_MAX_SERVERS 4
+
+// Offsets below this are slewed via adjtime(), above the clock is stepped:
+#define NTP_STEP_THRESHOLD_US 1000000LL
+
+// Samples with a round trip above this are never used:
+#define NTP_MAX_DELAY_US 1000000LL
+
+// Samples are accepted if delay <= 2 * best delay of the round + margin:
+#define NTP_DELAY_MARGIN_US 10000LL
+
+struct ntp_sample {
+	int64_t offset_us; // server time - local time
+	int64_t delay_us; // round trip, without the server processing time
+};
+
+enum ntp_action {
+	NTP_ACTION_NONE,
+	NTP_ACTION_SLEW,
+	NTP_ACTION_STEP,
+};
+
+struct ntp_state {
+	// Samples of the running poll round, one per answering server:
+	struct ntp_sample samples[NTP_MAX_SERVERS];
+	int sample_count;
+
+	// Result of the last completed round:
+	bool synced;
+	int64_t offset_us;
+	int64_t delay_us;
+	int64_t jitter_us;
+	int used_samples;
+	uint32_t last_sync_ms;
+};
+
+// Fill a client request, t1_us is stored as transmit timestamp and must be
+// passed unchanged to ntp_parse_response().
+void ntp_build_request(uint8_t *packet, int64_t t1_us);
+
+// Validate a server answer and calculate offset and delay.
+// t1_us: local send time, t4_us: local receive time.
+bool ntp_parse_response(const uint8_t *packet, size_t len, int64_t t1_us, int64_t t4_us, struct ntp_sample *sample);
+
+void ntp_round_begin(struct ntp_state *state);
+void ntp_round_add(struct ntp_state *state, const struct ntp_sample *sample);
+
+// Filter the samples of the round by round trip delay and decide how the local
+// clock must be corrected. The correction to apply is returned in correction_us.
+enum ntp_action ntp_round_end(struct ntp_state *state, uint32_t now_ms, int64_t *correction_us);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// Recorder for the byte stream between u8g2 and the display.
+//
+// Records are written into a caller supplied ring buffer, when it's full the
+// oldest records are dropped. Record format (first byte = type << 5 | arg):
+//
+//   START, END, FRAME  followed by the time since the previous START/END/FRAME
+//                      in us (LEB128 varint). START: arg = panel (chip select)
+//                      of the transfer, END/FRAME: arg unused
+//   DC                 arg = level of the DC line (0 = command, 1 = data)
+//   DATA               arg = length 1..31, or 0 and the length follows in the
+//                      next byte, followed by the bytes sent
+//
+// A dump is a SPI_TRACE_HEADER_SIZE header followed by the records, see
+// spi_trace_header(). tools/vfd_trace.py analyzes dumps.
+//-----------------------------------------------------------------------------
+
+#define SPI_TRACE_START 0
+#define SPI_TRACE_END 1
+#define SPI_TRACE_FRAME 2
+#define SPI_TRACE_DC 3
+#define SPI_TRACE_DATA 4
+
+#define SPI_TRACE_HEADER_SIZE 20
+#define SPI_TRACE_VERSION 1
+
+struct spi_trace {
+	uint8_t *buf;
+	uint32_t size;
+	uint32_t tail; // Oldest record
+	uint32_t used;
+	uint32_t dropped; // Records dropped because the buffer was full
+	uint32_t last_us;
+	bool enabled;
+};
+
+void spi_trace_init(struct spi_trace *trace, uint8_t *buf, uint32_t size);
+void spi_trace_clear(struct spi_trace *trace);
+
+// START, END or FRAME, arg (0..31) goes into the first byte:
+void spi_trace_event(struct spi_trace *trace, uint8_t type, uint8_t arg, uint32_t now_us);
+void spi_trace_dc(struct spi_trace *trace, uint8_t dc);
+void spi_trace_data(struct spi_trace *trace, const uint8_t *data, uint32_t len);
+
+// Write the dump header into out, spi_hz is the configured bus clock.
+void spi_trace_header(const struct spi_trace *trace, uint32_t spi_hz, uint8_t *out);
+
+// Copy up to len record bytes, starting offset bytes after the oldest record.
+uint32_t spi_trace_read(const struct spi_trace *trace, uint32_t offset, uint8_t *out, uint32_t len);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// Windowed telemetry: gauges are aggregated (min/max/mean/count) without any
+// allocation and reported once per window as CBOR (RFC 8949) map:
+//
+//   { "v": 1, "t": <unix time>, "w": <window seconds>,
+//     "g": { "<gauge>": [min, max, mean, count], ... } }
+//
+// Gauges without samples in the window are left out.
+//-----------------------------------------------------------------------------
+
+#define TELEMETRY_MAX_GAUGES 8
+#define TELEMETRY_VERSION 1
+
+struct telemetry_gauge {
+	const char *name;
+	int32_t min;
+	int32_t max;
+	int64_t sum;
+	uint32_t count;
+};
+
+struct telemetry {
+	struct telemetry_gauge gauges[TELEMETRY_MAX_GAUGES];
+	int gauge_count;
+};
+
+// Returns the gauge index for telemetry_sample(), -1 if all slots are used.
+int telemetry_add_gauge(struct telemetry *telemetry, const char *name);
+void telemetry_sample(struct telemetry *telemetry, int gauge, int32_t value);
+
+// Start a new window, the gauges are kept.
+void telemetry_reset(struct telemetry *telemetry);
+
+// Returns the payload size, 0 if out is too small.
+size_t telemetry_encode(const struct telemetry *telemetry, uint32_t unix_time, uint32_t window_s, uint8_t *out, size_t size);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// Virtual canvas spanning several GP1287 panels side by side.
+//
+// u8g2 renders into the canvas once, the tiles (8x8 pixel) are routed to the
+// panel slices and compared with what the panel already shows. A flush sends
+// only the changed tiles, panel by panel, merged into runs per tile row.
+// The transport is a callback, so routing can be checked without hardware.
+//-----------------------------------------------------------------------------
+
+#ifndef VFD_MAX_PANELS
+#define VFD_MAX_PANELS 4
+#endif
+
+#define VFD_PANEL_TILE_COLS 32 // 256 pixel
+#define VFD_PANEL_TILE_ROWS 7 // 50 pixel, rounded up
+
+// u8x8 tile positions are uint8_t, the dirty masks have a bit per column:
+static_assert(VFD_MAX_PANELS * VFD_PANEL_TILE_COLS <= 255, "VFD_MAX_PANELS too large for u8x8 tile positions");
+static_assert(VFD_PANEL_TILE_COLS <= 32, "dirty mask is uint32_t");
+
+// Send cnt tiles to panel, starting at tile x/y of the panel:
+typedef void (*vfd_canvas_send_cb)(void *context, int panel, uint8_t x, uint8_t y, uint8_t cnt, uint8_t *tiles);
+
+struct vfd_canvas {
+	int panels;
+	bool horizontal; // Buffer layout of u8g2_ll_hvline_horizontal_right_lsb instead of vertical_top_lsb
+
+	uint8_t tiles[VFD_MAX_PANELS][VFD_PANEL_TILE_ROWS][VFD_PANEL_TILE_COLS][8];
+	uint32_t dirty[VFD_MAX_PANELS][VFD_PANEL_TILE_ROWS]; // Bit per tile column, not sent yet
+};
+
+// Returns false (and the canvas has no panels) unless 1 <= panels <= VFD_MAX_PANELS.
+bool vfd_canvas_init(struct vfd_canvas *canvas, int panels, bool horizontal);
+
+// Mark all tiles for sending, eg. after a panel was initialized.
+void vfd_canvas_invalidate(struct vfd_canvas *canvas);
+
+// Tiles as delivered by u8g2 (U8X8_MSG_DISPLAY_DRAW_TILE), x/y in canvas tiles.
+void vfd_canvas_draw_tiles(struct vfd_canvas *canvas, uint8_t x, uint8_t y, uint8_t cnt, const uint8_t *ptr);
+
+// Send all changed tiles, returns the number of tiles sent.
+int vfd_canvas_flush(struct vfd_canvas *canvas, vfd_canvas_send_cb send, void *context);
@@ -0,0 +1,117 @@
+#include "analog_face.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fixed_trig.h"
+
+static void dial_set_pixel(uint8_t *bitmap, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= DIAL_SIZE || y >= DIAL_SIZE)
+		return;
+	bitmap[y * DIAL_BYTES_PER_ROW + (x >> 3)] |= 1 << (x & 7);
+}
+
+void analog_face_line(uint8_t *bitmap, int x0, int y0, int x1, int y1)
+{
+	int dx = abs(x1 - x0);
+	int dy = -abs(y1 - y0);
+	int sx = x0 < x1 ? 1 : -1;
+	int sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	for (;;) {
+		dial_set_pixel(bitmap, x0, y0);
+		if (x0 == x1 && y0 == y1)
+			break;
+		int e2 = 2 * err;
+		if (e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+// Midpoint circle around the dial center:
+static void dial_circle(uint8_t *bitmap, int r)
+{
+	int c = DIAL_RADIUS;
+	int x = r;
+	int y = 0;
+	int err = 1 - r;
+
+	while (x >= y) {
+		dial_set_pixel(bitmap, c + x, c + y);
+		dial_set_pixel(bitmap, c + y, c + x);
+		dial_set_pixel(bitmap, c - y, c + x);
+		dial_set_pixel(bitmap, c - x, c + y);
+		dial_set_pixel(bitmap, c - x, c - y);
+		dial_set_pixel(bitmap, c - y, c - x);
+		dial_set_pixel(bitmap, c + y, c - x);
+		dial_set_pixel(bitmap, c + x, c - y);
+		y++;
+		if (err < 0) {
+			err += 2 * y + 1;
+		}
+		else {
+			x--;
+			err += 2 * (y - x) + 1;
+		}
+	}
+}
+
+void analog_face_build_dial(uint8_t *bitmap)
+{
+	int c = DIAL_RADIUS;
+
+	memset(bitmap, 0, DIAL_BYTES_PER_ROW * DIAL_SIZE);
+	dial_circle(bitmap, DIAL_RADIUS);
+
+	for (int i = 0; i < 60; i++) {
+		int angle = i * FX_ANGLE_STEPS / 60;
+		int s = fx_sin(angle);
+		int co = fx_cos(angle);
+
+		if (i % 5 == 0) // Hour tick
+			analog_face_line(bitmap, c + fx_mul(DIAL_RADIUS - 5, s), c - fx_mul(DIAL_RADIUS - 5, co), c + fx_mul(DIAL_RADIUS - 2, s), c - fx_mul(DIAL_RADIUS - 2, co));
+		else
+			dial_set_pixel(bitmap, c + fx_mul(DIAL_RADIUS - 2, s), c - fx_mul(DIAL_RADIUS - 2, co));
+	}
+}
+
+void analog_face_hands(const struct tm *now, int ms, struct analog_hands *hands)
+{
+	long ms_of_minute = now->tm_sec * 1000L + ms;
+	long sec_of_hour = now->tm_min * 60L + now->tm_sec;
+	long sec_of_half_day = (now->tm_hour % 12) * 3600L + sec_of_hour;
+
+	hands->hour.angle = (int)(sec_of_half_day * FX_ANGLE_STEPS / (12 * 3600L));
+	hands->hour.length = DIAL_RADIUS * 9 / 16;
+	hands->hour.width = 1;
+
+	hands->minute.angle = (int)(sec_of_hour * FX_ANGLE_STEPS / 3600L);
+	hands->minute.length = DIAL_RADIUS * 13 / 16;
+	hands->minute.width = 1;
+
+	// Moves smoothly between the seconds:
+	hands->second.angle = (int)(ms_of_minute * FX_ANGLE_STEPS / 60000L);
+	hands->second.length = DIAL_RADIUS * 15 / 16;
+	hands->second.width = 0;
+}
+
+// u8g2 lines are integer Bresenham, so a wide hand is made of parallel lines:
+void analog_face_draw_hand(int cx, int cy, const struct analog_hand *hand, analog_line_cb line, void *context)
+{
+	int x = cx + fx_mul(hand->length, fx_sin(hand->angle));
+	int y = cy - fx_mul(hand->length, fx_cos(hand->angle));
+
+	for (int w = -hand->width; w <= hand->width; w++) {
+		int ox = fx_mul(w, fx_cos(hand->angle));
+		int oy = fx_mul(w, fx_sin(hand->angle));
+		line(context, cx + ox, cy + oy, x, y);
+	}
+}
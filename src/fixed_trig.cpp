@@ -0,0 +1,27 @@
+#include "fixed_trig.h"
+
+// Taylor series, evaluated at compile time (C++11 constexpr, so recursive).
+// Only used for 0 <= x <= pi/2, where 10 terms are far below 1/FX_ONE.
+static constexpr double sin_series(double x2, double term, int k)
+{
+	return k > 10 ? 0.0 : term + sin_series(x2, -term * x2 / ((2 * k) * (2 * k + 1)), k + 1);
+}
+
+static constexpr double table_angle(int i)
+{
+	return i * 1.5707963267948966 / FX_QUARTER; // pi/2 per quarter
+}
+
+static constexpr int16_t sin_entry(int i)
+{
+	return (int16_t)(sin_series(table_angle(i) * table_angle(i), table_angle(i), 1) * FX_ONE + 0.5);
+}
+
+#define SIN_4(i) sin_entry(i), sin_entry(i + 1), sin_entry(i + 2), sin_entry(i + 3)
+#define SIN_16(i) SIN_4(i), SIN_4(i + 4), SIN_4(i + 8), SIN_4(i + 12)
+#define SIN_64(i) SIN_16(i), SIN_16(i + 16), SIN_16(i + 32), SIN_16(i + 48)
+#define SIN_256(i) SIN_64(i), SIN_64(i + 64), SIN_64(i + 128), SIN_64(i + 192)
+
+static_assert(FX_QUARTER == 256, "table initializer below expects 256 steps per quarter");
+
+const int16_t fx_sin_table[FX_QUARTER + 1] = { SIN_256(0), sin_entry(FX_QUARTER) };
@@ -0,0 +1,61 @@
+#include "font_subset.h"
+
+// Generated by the pre build script tools/font_subset.py:
+#include "font_subset_data.h"
+
+uint16_t utf8_next(const char **text)
+{
+	const uint8_t *p = (const uint8_t *)*text;
+	uint16_t code = p[0];
+
+	if (code == 0)
+		return 0;
+
+	if (code < 0x80) {
+		*text += 1;
+	}
+	else if ((code & 0xe0) == 0xc0 && (p[1] & 0xc0) == 0x80) {
+		code = ((code & 0x1f) << 6) | (p[1] & 0x3f);
+		*text += 2;
+	}
+	else {
+		// 3/4 byte sequences or broken UTF-8, not part of our fonts:
+		code = 0xfffd;
+		do {
+			*text += 1;
+		} while ((**text & 0xc0) == 0x80);
+	}
+	return code;
+}
+
+void subset_draw_glyph(const struct subset_font *font, const struct subset_glyph *glyph, int x, int y, int clip_top, int clip_bottom, subset_hline_cb hline,
+                       void *context)
+{
+	const uint8_t *bits = font->bitmaps + glyph->bitmap;
+	int bytes_per_row = (glyph->width + 7) / 8;
+
+	x += glyph->x_offset;
+	y -= glyph->height + glyph->y_offset;
+
+	int first = clip_top - y;
+	int last = clip_bottom - y;
+	if (first < 0)
+		first = 0;
+	if (last > glyph->height)
+		last = glyph->height;
+
+	bits += first * bytes_per_row;
+	for (int row = first; row < last; row++, bits += bytes_per_row) {
+		int start = -1;
+		for (int col = 0; col <= glyph->width; col++) {
+			bool on = col < glyph->width && ((bits[col >> 3] >> (col & 7)) & 1);
+			if (on && start < 0) {
+				start = col;
+			}
+			else if (!on && start >= 0) {
+				hline(context, x + start, y + row, col - start);
+				start = -1;
+			}
+		}
+	}
+}
@@ -19,6 +19,12 @@
 #endif
 
 #include "arduino_secrets.h"
+#include "ntp_client.h"
+#include "font_subset.h"
+#include "analog_face.h"
+#include "spi_trace.h"
+#include "telemetry.h"
+#include "vfd_canvas.h"
 
 //-----------------------------------------------------------------------------
 // Language texts:
@@ -75,6 +81,19 @@ const byte PIN_VFD_CLOCK = 2;
 const byte PIN_VFD_DATA = 32;
 const byte PIN_VFD_CHIPSELECT = 5;
 
+// More panels side by side share CLOCK, DATA and RESET, each has its own CS.
+// (u8g2 is then a canvas spanning all panels, see vfd_canvas.h)
+#ifndef VFD_PANEL_COUNT
+#define VFD_PANEL_COUNT 1
+#endif
+
+// Chip select of each panel, left to right:
+const byte vfd_cs_pins[] = { PIN_VFD_CHIPSELECT, 4, 16, 17 };
+
+static_assert(VFD_PANEL_COUNT >= 1 && VFD_PANEL_COUNT <= VFD_MAX_PANELS, "VFD_PANEL_COUNT: 1 .. VFD_MAX_PANELS");
+static_assert(VFD_PANEL_COUNT <= sizeof(vfd_cs_pins), "vfd_cs_pins: a chip select per panel");
+static_assert(VFD_PANEL_COUNT * VFD_PANEL_TILE_COLS <= 255, "u8x8 tile_width is uint8_t");
+
 //-----------------------------------------------------------------------------
 // Preferences declarations:
 //-----------------------------------------------------------------------------
@@ -91,31 +110,135 @@ void setup_after_WIFI_connect();
 // MQTT declarations:
 //-----------------------------------------------------------------------------
 WiFiClient net;
+#ifdef VFD_TRACE
+MQTTClient mqtt(1024); // Big enough for binary chunks of the VFD trace
+#else
 MQTTClient mqtt;
+#endif
 
 void setup_MQTT();
 
+void mqtt_publish(const char *topic, const char *message);
 void mqtt_log(const char *message);
 void mqtt_log(String message);
 
 //-----------------------------------------------------------------------------
 // VFD-Display declarations:
 //-----------------------------------------------------------------------------
+#if VFD_PANEL_COUNT == 1
 U8G2_GP1287AI_256X50_1_4W_HW_SPI
 u8g2(U8G2_R2, /* cs=*/PIN_VFD_CHIPSELECT, /* dc=*/PIN_VFD_CLOCK, /* reset=*/PIN_VFD_RESET /* U8X8_PIN_NONE , PIN_VFD_RESET */);
+#else
+// Left to right, only the first panel pulses the shared reset line:
+#define VFD_PANEL(i) { U8G2_R0, /* cs=*/vfd_cs_pins[i], /* dc=*/PIN_VFD_CLOCK, /* reset=*/(i) == 0 ? PIN_VFD_RESET : (uint8_t)U8X8_PIN_NONE }
+
+U8G2_GP1287AI_256X50_1_4W_HW_SPI vfd_panels[VFD_PANEL_COUNT] = {
+	VFD_PANEL(0),
+	VFD_PANEL(1),
+#if VFD_PANEL_COUNT > 2
+	VFD_PANEL(2),
+#endif
+#if VFD_PANEL_COUNT > 3
+	VFD_PANEL(3),
+#endif
+};
+
+u8x8_display_info_t vfd_canvas_display_info; // Panel info, N times wider
+uint8_t vfd_canvas_page[VFD_PANEL_COUNT * VFD_PANEL_TILE_COLS * 8]; // One tile row
+struct vfd_canvas vfd_tiles;
+
+uint8_t vfd_canvas_display_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
+
+// u8g2 drawing into the canvas, the panels get the changed tiles with each nextPage() round:
+class U8G2_VFD_CANVAS : public U8G2 {
+public:
+	U8G2_VFD_CANVAS(const u8g2_cb_t *rotation)
+		: U8G2()
+	{
+		u8g2_t *panel = vfd_panels[0].getU8g2();
+
+		vfd_canvas_display_info = *vfd_panels[0].getU8x8()->display_info;
+		vfd_canvas_display_info.tile_width *= VFD_PANEL_COUNT;
+		vfd_canvas_display_info.pixel_width *= VFD_PANEL_COUNT;
+
+		u8g2_SetupDisplay(&u8g2, vfd_canvas_display_cb, u8x8_cad_empty, u8x8_byte_empty, u8x8_dummy_cb);
+		u8g2_SetupBuffer(&u8g2, vfd_canvas_page, 1, panel->ll_hvline, rotation);
+		vfd_canvas_init(&vfd_tiles, VFD_PANEL_COUNT, panel->ll_hvline == u8g2_ll_hvline_horizontal_right_lsb); // Count checked above
+	}
+};
+
+U8G2_VFD_CANVAS u8g2(U8G2_R0);
+#endif
+
+u8x8_t *vfd_panel_u8x8(int panel);
 
 void display_OTA_info(unsigned int progress, unsigned int total);
 
+//-----------------------------------------------------------------------------
+// VFD SPI trace declarations:
+// (opt-in via build flag -D VFD_TRACE, controlled via MQTT <mqtt_topic>/trace/cmd:
+//  "start", "stop", "dump" (to <mqtt_topic>/trace/data) or "dump serial")
+//-----------------------------------------------------------------------------
+#ifdef VFD_TRACE
+#ifndef VFD_TRACE_SIZE
+#define VFD_TRACE_SIZE (16 * 1024)
+#endif
+
+uint8_t vfd_trace_buffer[VFD_TRACE_SIZE];
+struct spi_trace vfd_trace;
+
+#define VFD_TRACE_CHUNK_SIZE 512
+#define VFD_TRACE_CHUNKS_PER_LOOP 2 // Keep the display running while dumping
+
+u8x8_msg_cb vfd_byte_cb; // Original u8g2 SPI transport (same for all panels)
+
+// Set by the MQTT callback, executed by loop_VFD_trace():
+String vfd_trace_pending_command;
+
+// Running dump, -1 = none:
+int32_t vfd_trace_dump_offset = -1;
+bool vfd_trace_dump_serial;
+bool vfd_trace_dump_was_enabled;
+#endif
+
+void setup_VFD_trace();
+void loop_VFD_trace();
+void vfd_trace_frame();
+
 //-----------------------------------------------------------------------------
 // HTTP declarations:
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
 // NTP declarations:
-// (we are using the ESP internal NTP implementation...)
+// (own SNTP client, the clock is slewed via adjtime() instead of stepped)
 //-----------------------------------------------------------------------------
 void setup_NTP();
 void setTimezone(String tz);
+void ntp_publish_status();
+
+const char *ntp_servers[] = { "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org" };
+const int ntp_server_count = sizeof(ntp_servers) / sizeof(ntp_servers[0]);
+
+const unsigned long NTP_POLL_INTERVAL_MS = 1000 * 64 * 2; // When synced
+const unsigned long NTP_RETRY_INTERVAL_MS = 1000 * 16; // Until first sync
+const unsigned long NTP_ANSWER_TIMEOUT_MS = 1000;
+const unsigned long NTP_RESOLVE_INTERVAL_MS = 1000UL * 60 * 60 * 24; // Follow pool DNS changes
+
+// hostByName() blocks, so the addresses are only resolved again daily or
+// when a server stopped answering. 0.0.0.0 = not resolved.
+IPAddress ntp_server_ips[sizeof(ntp_servers) / sizeof(ntp_servers[0])];
+unsigned long ntp_resolve_ms;
+
+WiFiUDP ntp_udp;
+struct ntp_state ntp;
+
+Neotimer ntp_poll_timer = Neotimer(NTP_RETRY_INTERVAL_MS);
+
+int ntp_server_idx = -1; // Server we are waiting for, -1 = no round running
+unsigned long ntp_request_ms;
+int64_t ntp_request_us;
+bool ntp_answered;
 
 String timezone = "UTC0";
 
@@ -127,11 +250,34 @@ bool timezone_setup_done = false;
 
 struct tm timeinfo; // Updated in loop
 
+//-----------------------------------------------------------------------------
+// Telemetry declarations:
+// (aggregated per window, published as CBOR to <mqtt_topic>/telemetry)
+//-----------------------------------------------------------------------------
+const uint32_t TELEMETRY_WINDOW_S = 60 * 5;
+
+struct telemetry telemetry;
+
+int gauge_ldr, gauge_brightness, gauge_heap_free, gauge_rssi, gauge_frame_us, gauge_ntp_offset_us;
+
+Neotimer telemetry_timer = Neotimer(TELEMETRY_WINDOW_S * 1000);
+
 //-----------------------------------------------------------------------------
 // Clock declarations:
 //-----------------------------------------------------------------------------
+#define CLOCK_FACE_DIGITAL 0
+#define CLOCK_FACE_ANALOG 1
+
+#define CLOCK_FACE CLOCK_FACE_DIGITAL
+
 int ldr, brightness, sec;
 
+// Analog face: the dial (circle & ticks) is rendered once into a bitmap,
+// per frame only the hands are drawn.
+uint8_t dial_bitmap[DIAL_BYTES_PER_ROW * DIAL_SIZE];
+
+Neotimer frame_timer = Neotimer(40); // 25 fps for the analog second hand
+
 //-----------------------------------------------------------------------------
 // Utils code:
 //-----------------------------------------------------------------------------
@@ -310,16 +456,107 @@ void setTimezone(String tz)
 // 	settimeofday(&now, NULL);
 // }
 
-void initTime(String timezone)
+int64_t local_time_us()
 {
-	log("Setting up time");
-	configTime(0, 0, "pool.ntp.org"); // First connect to NTP server, with 0 TZ offset
-	if (!getLocalTime(&timeinfo)) {
-		log("  Failed to obtain time");
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void ntp_send_request()
+{
+	// Drop late answers of the previous server:
+	while (ntp_udp.parsePacket() > 0)
+		ntp_udp.flush();
+
+	IPAddress &ip = ntp_server_ips[ntp_server_idx];
+	if ((uint32_t)ip == 0 && !WiFi.hostByName(ntp_servers[ntp_server_idx], ip)) {
+		log("NTP: Can't resolve %s", ntp_servers[ntp_server_idx]);
+		ip = IPAddress();
+		ntp_request_ms = millis() - NTP_ANSWER_TIMEOUT_MS; // Next server with the next loop
+		return;
+	}
+
+	uint8_t packet[NTP_PACKET_SIZE];
+	ntp_answered = false;
+	ntp_request_ms = millis();
+	ntp_request_us = local_time_us();
+	ntp_build_request(packet, ntp_request_us);
+
+	ntp_udp.beginPacket(ip, NTP_PORT);
+	ntp_udp.write(packet, sizeof(packet));
+	ntp_udp.endPacket();
+}
+
+void ntp_start_round()
+{
+	if (millis() - ntp_resolve_ms >= NTP_RESOLVE_INTERVAL_MS) {
+		for (int i = 0; i < ntp_server_count; i++)
+			ntp_server_ips[i] = IPAddress();
+		ntp_resolve_ms = millis();
+	}
+
+	ntp_round_begin(&ntp);
+	ntp_server_idx = 0;
+	ntp_send_request();
+}
+
+void ntp_discipline(enum ntp_action action, int64_t correction_us)
+{
+	if (action == NTP_ACTION_STEP) {
+		int64_t now = local_time_us() + correction_us;
+		struct timeval tv = { .tv_sec = (time_t)(now / 1000000), .tv_usec = (suseconds_t)(now % 1000000) };
+		settimeofday(&tv, NULL);
+	}
+	else if (action == NTP_ACTION_SLEW) {
+		struct timeval delta = { .tv_sec = (time_t)(correction_us / 1000000), .tv_usec = (suseconds_t)(correction_us % 1000000) };
+		adjtime(&delta, NULL);
+	}
+}
+
+void ntp_end_round()
+{
+	ntp_server_idx = -1;
+
+	int64_t correction_us;
+	enum ntp_action action = ntp_round_end(&ntp, millis(), &correction_us);
+	if (action == NTP_ACTION_NONE) {
+		log("NTP: No usable answer");
 		return;
 	}
-	log("  Got the time from NTP");
-	//setTimezone(timezone);
+
+	ntp_discipline(action, correction_us);
+	ntp_poll_timer.set(NTP_POLL_INTERVAL_MS);
+
+	if (action == NTP_ACTION_SLEW) // Steps are not the quality of the clock
+		telemetry_sample(&telemetry, gauge_ntp_offset_us, (int32_t)ntp.offset_us);
+
+	log("NTP: %s %.3f ms, delay %.3f ms, jitter %.3f ms, %d/%d samples", action == NTP_ACTION_STEP ? "step" : "slew", ntp.offset_us / 1000.0, ntp.delay_us / 1000.0,
+	    ntp.jitter_us / 1000.0, ntp.used_samples, ntp.sample_count);
+	ntp_publish_status();
+}
+
+void ntp_publish_status()
+{
+	if (!ntp.synced)
+		return;
+
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%.3f", ntp.offset_us / 1000.0);
+	mqtt_publish("/ntp/offset_ms", buf);
+	snprintf(buf, sizeof(buf), "%.3f", ntp.jitter_us / 1000.0);
+	mqtt_publish("/ntp/jitter_ms", buf);
+	snprintf(buf, sizeof(buf), "%.3f", ntp.delay_us / 1000.0);
+	mqtt_publish("/ntp/delay_ms", buf);
+	snprintf(buf, sizeof(buf), "%lu", (millis() - ntp.last_sync_ms) / 1000);
+	mqtt_publish("/ntp/last_sync_age_s", buf);
+}
+
+void initTime()
+{
+	log("Setting up time");
+	ntp_udp.begin(NTP_PORT);
+	ntp_resolve_ms = millis();
 }
 
 // void printLocalTime()
@@ -387,7 +624,7 @@ void setup_timezone()
 				log("timezone_definition is %s", timezone_definition.c_str());
 				//printLocalTime();
 				setTimezone(timezone_definition);
-				getLocalTime(&timeinfo);
+				getLocalTime(&timeinfo, 0); // The TZ works without a valid time, don't wait for the NTP sync
 
 				timezone_setup_done = true;
 				preferences.putString("tz_definition", timezone_definition); // timezone_definition > 15 chars, so use tz_definition as key...
@@ -400,16 +637,47 @@ void setup_timezone()
 
 void setup_NTP()
 {
-	initTime(timezone);
+	initTime();
 
 	setup_timezone();
+
+	// After the HTTP lookups, they would delay reading the answers and spoil the round trip:
+	ntp_start_round();
 }
 
 void loop_NTP()
 {
-	// NTP is running in the background, started by configTime() in initTime()
-	getLocalTime(&timeinfo);
-	//ntp.update();
+	if (ntp_server_idx >= 0) {
+		int len = ntp_udp.parsePacket();
+		if (len > 0) {
+			int64_t received_us = local_time_us();
+			uint8_t packet[NTP_PACKET_SIZE];
+			struct ntp_sample sample;
+
+			len = ntp_udp.read(packet, sizeof(packet));
+			if (ntp_parse_response(packet, len, ntp_request_us, received_us, &sample))
+				ntp_round_add(&ntp, &sample);
+			else
+				log("NTP: Invalid answer from %s", ntp_servers[ntp_server_idx]);
+			ntp_answered = true;
+			ntp_request_ms = millis() - NTP_ANSWER_TIMEOUT_MS; // Answer done, next server
+		}
+
+		if (millis() - ntp_request_ms >= NTP_ANSWER_TIMEOUT_MS) {
+			if (!ntp_answered)
+				ntp_server_ips[ntp_server_idx] = IPAddress(); // Pool member may be gone, resolve again next round
+			if (++ntp_server_idx < ntp_server_count)
+				ntp_send_request();
+			else
+				ntp_end_round();
+		}
+	}
+	else if (ntp_poll_timer.repeat()) {
+		ntp_start_round();
+	}
+
+	// Don't wait for a valid time, the display shows the time since boot until then:
+	getLocalTime(&timeinfo, 0);
 }
 
 //-----------------------------------------------------------------------------
@@ -419,6 +687,12 @@ void loop_NTP()
 void messageReceived(String &topic, String &payload)
 {
 	Serial.println("incoming: " + topic + " - " + payload);
+
+#ifdef VFD_TRACE
+	// Not from within the MQTT client, the dump publishes a lot:
+	if (topic == mqtt_topic + "/trace/cmd")
+		vfd_trace_pending_command = payload;
+#endif
 }
 
 void mqtt_publish(const char *topic, const char *message)
@@ -454,6 +728,10 @@ void mqtt_log(String message)
 void mqtt_subscribe()
 {
 	log("started...");
+
+#ifdef VFD_TRACE
+	mqtt.subscribe(mqtt_topic + "/trace/cmd");
+#endif
 }
 
 void mqtt_last_will()
@@ -512,11 +790,59 @@ void setup_VFD()
 	digitalWrite(PIN_VFD_LDR, HIGH);
 	pinMode(PIN_VFD_LDR, INPUT_PULLUP);
 
+	setup_VFD_trace(); // Before begin(), to see the init sequence
+
+#if VFD_PANEL_COUNT > 1
+	for (int i = 0; i < VFD_PANEL_COUNT; i++)
+		vfd_panels[i].begin();
+#endif
 	u8g2.begin();
 
 	u8g2.setDisplayRotation(U8G2_R0);
 
-	u8g2.enableUTF8Print(); // enable UTF8 support for the Arduino print() function
+#if CLOCK_FACE == CLOCK_FACE_ANALOG
+	analog_face_build_dial(dial_bitmap);
+#endif
+}
+
+void draw_glyph_hline(void *context, int x, int y, int len)
+{
+	u8g2.drawHLine(x, y, len);
+}
+
+// Like u8g2.printf() with a subset font, y is the baseline. Returns the x position behind the text.
+int draw_text(const struct subset_font *font, int x, int y, const char *format, ...)
+{
+	va_list arg;
+	va_start(arg, format);
+
+	char buf[64];
+	vsnprintf(buf, sizeof(buf), format, arg);
+	va_end(arg);
+
+	// Only the rows of the current page, the rotation is U8G2_R0 (see setup_VFD()):
+	int page_top = u8g2.getBufferCurrTileRow() * 8;
+	int page_bottom = page_top + u8g2.getBufferTileHeight() * 8;
+
+	const char *text = buf;
+	uint16_t code;
+	while ((code = utf8_next(&text)) != 0) {
+		const struct subset_glyph *glyph = subset_font_glyph(font, code);
+		if (glyph == NULL) {
+			// tools/font_subset.py didn't see this text, show a box instead of dropping it:
+			static bool missing_logged = false;
+			if (!missing_logged) {
+				log("Font: no glyph for U+%04X in \"%s\", check tools/font_subset.py", code, buf);
+				missing_logged = true;
+			}
+			u8g2.drawFrame(x, y - font->max_height, font->max_width, font->max_height);
+			x += font->max_width + 1;
+			continue;
+		}
+		subset_draw_glyph(font, glyph, x, y, page_top, page_bottom, draw_glyph_hline, NULL);
+		x += glyph->advance;
+	}
+	return x;
 }
 
 void draw_horizontal_segment(int x, int y, int w)
@@ -664,11 +990,32 @@ void draw_current_time(int x, int y)
 	draw_2_numbers(x, y, timeinfo.tm_sec, dw, dwv, dh, dhv);
 }
 
+void draw_hand_line(void *context, int x0, int y0, int x1, int y1)
+{
+	u8g2.drawLine(x0, y0, x1, y1);
+}
+
+// now/ms must be read once per frame, otherwise the hands differ between the pages:
+void draw_analog_time(int x, int y, const struct tm *now, int ms)
+{
+	int cx = x + DIAL_RADIUS;
+	int cy = y + DIAL_RADIUS;
+
+	struct analog_hands hands;
+	analog_face_hands(now, ms, &hands);
+
+	u8g2.drawXBM(x, y, DIAL_SIZE, DIAL_SIZE, dial_bitmap);
+
+	analog_face_draw_hand(cx, cy, &hands.hour, draw_hand_line, NULL);
+	analog_face_draw_hand(cx, cy, &hands.minute, draw_hand_line, NULL);
+	analog_face_draw_hand(cx, cy, &hands.second, draw_hand_line, NULL);
+
+	u8g2.drawDisc(cx, cy, 1);
+}
+
 void draw_current_date(int x, int y)
 {
-	u8g2.setFont(u8g2_font_5x8_tf);
-	u8g2.setCursor(x, y + 8);
-	u8g2.printf("%s   ", week_days_long[timeinfo.tm_wday]);
+	draw_text(&font_5x8_subset, x, y + 8, "%s", week_days_long[timeinfo.tm_wday]);
 
 	if (timeinfo.tm_mday < 10) {
 		draw_digit(x + 31, y + 2, timeinfo.tm_mday, 7, 2, 8, 2);
@@ -679,10 +1026,7 @@ void draw_current_date(int x, int y)
 
 	u8g2.drawBox(x + 61, y + 23, 3, 3);
 
-	u8g2.setFont(u8g2_font_6x10_tf);
-	//u8g2.setFont(u8g2_font_10x20_tf);
-	u8g2.setCursor(x, y + 39);
-	u8g2.printf("%s, %d ", month_names_long[timeinfo.tm_mon], timeinfo.tm_year + 1900);
+	draw_text(&font_6x10_subset, x, y + 39, "%s, %d", month_names_long[timeinfo.tm_mon], timeinfo.tm_year + 1900);
 }
 
 void display_OTA_info(unsigned int progress, unsigned int total)
@@ -690,17 +1034,15 @@ void display_OTA_info(unsigned int progress, unsigned int total)
 	//return;
 	float percent = progress / (total / 100.0f);
 
-	u8g2.setFont(u8g2_font_6x10_tf);
+	vfd_trace_frame();
 	u8g2.firstPage();
 	do {
-		u8g2.setCursor(95, 15);
-		u8g2.printf("OTA Update...");
+		draw_text(&font_6x10_subset, 95, 15, "OTA Update...");
 
 		u8g2.drawFrame(0, 25, u8g2.getWidth(), 8);
 		u8g2.drawBox(0, 25, (u8g2_uint_t)(u8g2.getWidth() * percent / 100), 8);
 
-		u8g2.setCursor(60, 45);
-		u8g2.printf("%06u / %u = %2.1f%% ", progress, total, percent);
+		draw_text(&font_6x10_subset, 60, 45, "%06u / %u = %2.1f%%", progress, total, percent);
 	} while (u8g2.nextPage());
 }
 
@@ -708,23 +1050,275 @@ void loop_VFD_1sec()
 {
 	// u8g2.setFont(u8g2_font_ncenB14_tr);
 	int loops = 0;
+	unsigned long start_us = micros();
+
+#if CLOCK_FACE == CLOCK_FACE_ANALOG
+	// Read the clock once per frame, the second hand moves smoothly between the seconds:
+	struct timeval tv;
+	struct tm now;
+	gettimeofday(&tv, NULL);
+	localtime_r(&tv.tv_sec, &now);
+#endif
+
+	vfd_trace_frame();
 	u8g2.firstPage();
 	do {
 		loops++;
 
-		draw_current_time(0, 0);
+#if CLOCK_FACE == CLOCK_FACE_ANALOG
+		draw_analog_time(0, 0, &now, tv.tv_usec / 1000);
 		draw_current_date(150, 0);
 
-		//		u8g2.setFont(u8g2_font_10x20_me);
-		u8g2.setFont(u8g2_font_5x7_tf);
+		draw_text(&font_5x7_subset, DIAL_SIZE + 8, 49, "Free Memory = %ld  %d", ESP.getFreeHeap(), brightness);
+#else
+		draw_current_time(0, 0);
+		draw_current_date(150, 0);
 
-		u8g2.setCursor(0, 49);
-		u8g2.printf("Free Memory = %ld  %d  ", ESP.getFreeHeap(), brightness);
+		draw_text(&font_5x7_subset, 0, 49, "Free Memory = %ld  %d", ESP.getFreeHeap(), brightness);
+#endif
 	} while (u8g2.nextPage());
 
+	telemetry_sample(&telemetry, gauge_frame_us, micros() - start_us);
+
 	//log("Loops %d, Time= %s", loops, ntp.formattedTime("%A %C %F %H"));
 }
 
+//-----------------------------------------------------------------------------
+// VFD canvas code:
+//-----------------------------------------------------------------------------
+
+// u8x8 of a panel, the one talking to the hardware:
+u8x8_t *vfd_panel_u8x8(int panel)
+{
+#if VFD_PANEL_COUNT > 1
+	return vfd_panels[panel].getU8x8();
+#else
+	return u8g2.getU8x8();
+#endif
+}
+
+#if VFD_PANEL_COUNT > 1
+
+void vfd_canvas_send(void *context, int panel, uint8_t x, uint8_t y, uint8_t cnt, uint8_t *tiles)
+{
+	u8x8_DrawTile(vfd_panel_u8x8(panel), x, y, cnt, tiles);
+}
+
+// Display driver of the canvas, routes tiles to the panels:
+uint8_t vfd_canvas_display_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+	switch (msg) {
+		case U8X8_MSG_DISPLAY_SETUP_MEMORY:
+			u8x8_d_helper_display_setup_memory(u8x8, &vfd_canvas_display_info);
+			break;
+		case U8X8_MSG_DISPLAY_DRAW_TILE: {
+			// arg_int: how often the tiles are repeated (clearDisplay() uses this)
+			u8x8_tile_t *tile = (u8x8_tile_t *)arg_ptr;
+			for (int i = 0; i < arg_int; i++)
+				vfd_canvas_draw_tiles(&vfd_tiles, tile->x_pos + i * tile->cnt, tile->y_pos, tile->cnt, tile->tile_ptr);
+			break;
+		}
+		case U8X8_MSG_DISPLAY_REFRESH: // After the last page
+			vfd_canvas_flush(&vfd_tiles, vfd_canvas_send, NULL);
+			break;
+		case U8X8_MSG_DISPLAY_SET_CONTRAST:
+			for (int i = 0; i < VFD_PANEL_COUNT; i++)
+				vfd_panels[i].setContrast(arg_int);
+			break;
+		case U8X8_MSG_DISPLAY_SET_POWER_SAVE:
+			for (int i = 0; i < VFD_PANEL_COUNT; i++)
+				vfd_panels[i].setPowerSave(arg_int);
+			break;
+	}
+	return 1;
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// Telemetry code:
+//-----------------------------------------------------------------------------
+
+void setup_telemetry()
+{
+	gauge_ldr = telemetry_add_gauge(&telemetry, "ldr");
+	gauge_brightness = telemetry_add_gauge(&telemetry, "brightness");
+	gauge_heap_free = telemetry_add_gauge(&telemetry, "heap_free");
+	gauge_rssi = telemetry_add_gauge(&telemetry, "rssi");
+	gauge_frame_us = telemetry_add_gauge(&telemetry, "frame_us");
+	gauge_ntp_offset_us = telemetry_add_gauge(&telemetry, "ntp_offset_us");
+}
+
+void loop_telemetry_1sec()
+{
+	telemetry_sample(&telemetry, gauge_ldr, ldr);
+	telemetry_sample(&telemetry, gauge_brightness, brightness);
+	telemetry_sample(&telemetry, gauge_heap_free, ESP.getFreeHeap());
+	if (wifi_connected)
+		telemetry_sample(&telemetry, gauge_rssi, WiFi.RSSI());
+}
+
+void loop_telemetry()
+{
+	if (!telemetry_timer.repeat())
+		return;
+
+	uint8_t payload[256];
+	size_t len = telemetry_encode(&telemetry, time(NULL), TELEMETRY_WINDOW_S, payload, sizeof(payload));
+	telemetry_reset(&telemetry);
+
+	if (len == 0)
+		log("Telemetry: payload too big");
+	else if (mqtt.connected())
+		mqtt.publish(mqtt_topic + "/telemetry", (const char *)payload, len);
+}
+
+//-----------------------------------------------------------------------------
+// VFD SPI trace code:
+//-----------------------------------------------------------------------------
+
+#ifdef VFD_TRACE
+
+// Sits between u8g2 and the SPI transport, records everything that goes to the display:
+uint8_t vfd_trace_byte_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+	switch (msg) {
+		case U8X8_MSG_BYTE_START_TRANSFER: {
+			int panel = 0;
+			while (panel < VFD_PANEL_COUNT - 1 && vfd_panel_u8x8(panel) != u8x8)
+				panel++;
+			spi_trace_event(&vfd_trace, SPI_TRACE_START, panel, micros());
+			break;
+		}
+		case U8X8_MSG_BYTE_SET_DC:
+			spi_trace_dc(&vfd_trace, arg_int);
+			break;
+		case U8X8_MSG_BYTE_SEND:
+			spi_trace_data(&vfd_trace, (const uint8_t *)arg_ptr, arg_int);
+			break;
+	}
+
+	uint8_t result = vfd_byte_cb(u8x8, msg, arg_int, arg_ptr);
+
+	// After the transfer, so the record includes the time on the bus:
+	if (msg == U8X8_MSG_BYTE_END_TRANSFER)
+		spi_trace_event(&vfd_trace, SPI_TRACE_END, 0, micros());
+
+	return result;
+}
+
+void setup_VFD_trace()
+{
+	spi_trace_init(&vfd_trace, vfd_trace_buffer, sizeof(vfd_trace_buffer));
+
+	for (int i = 0; i < VFD_PANEL_COUNT; i++) {
+		u8x8_t *u8x8 = vfd_panel_u8x8(i);
+		vfd_byte_cb = u8x8->byte_cb;
+		u8x8->byte_cb = vfd_trace_byte_cb;
+	}
+}
+
+void vfd_trace_frame()
+{
+	spi_trace_event(&vfd_trace, SPI_TRACE_FRAME, 0, micros());
+}
+
+void vfd_trace_send(const uint8_t *data, uint32_t len, bool serial)
+{
+	if (!serial) {
+		mqtt.publish(mqtt_topic + "/trace/data", (const char *)data, len);
+		return;
+	}
+
+	for (uint32_t i = 0; i < len; i += 32) {
+		Serial.printf("TRACE: ");
+		for (uint32_t j = i; j < len && j < i + 32; j++)
+			Serial.printf("%02x", data[j]);
+		Serial.printf("\n");
+	}
+}
+
+// Header and records, read tools/vfd_trace.py for the analysis.
+// The dump is sent by loop_VFD_trace(), VFD_TRACE_CHUNKS_PER_LOOP chunks per loop.
+void vfd_trace_dump_start(bool serial)
+{
+	vfd_trace_dump_was_enabled = vfd_trace.enabled;
+	vfd_trace.enabled = false; // The buffer must not change while dumping
+	vfd_trace_dump_serial = serial;
+	vfd_trace_dump_offset = 0;
+}
+
+void vfd_trace_dump_chunk()
+{
+	uint8_t chunk[VFD_TRACE_CHUNK_SIZE];
+	uint32_t len = 0;
+
+	if (vfd_trace_dump_offset == 0) {
+		spi_trace_header(&vfd_trace, vfd_panel_u8x8(0)->bus_clock, chunk);
+		len = SPI_TRACE_HEADER_SIZE;
+	}
+	uint32_t n = spi_trace_read(&vfd_trace, vfd_trace_dump_offset, chunk + len, sizeof(chunk) - len);
+	vfd_trace_send(chunk, len + n, vfd_trace_dump_serial);
+	vfd_trace_dump_offset += n;
+
+	if ((uint32_t)vfd_trace_dump_offset >= vfd_trace.used) {
+		vfd_trace_dump_offset = -1;
+		vfd_trace.enabled = vfd_trace_dump_was_enabled;
+		log("VFD trace dump done: %u bytes", (unsigned)vfd_trace.used);
+	}
+}
+
+void vfd_trace_command(const String &command)
+{
+	if (command == "start") {
+		spi_trace_clear(&vfd_trace);
+		vfd_trace.enabled = true;
+	}
+	else if (command == "stop") {
+		vfd_trace.enabled = false;
+	}
+	else if (command == "dump") {
+		vfd_trace_dump_start(false);
+	}
+	else if (command == "dump serial") {
+		vfd_trace_dump_start(true);
+	}
+
+	if (vfd_trace_dump_offset >= 0)
+		log("VFD trace dump: %u bytes, %u records dropped", (unsigned)vfd_trace.used, (unsigned)vfd_trace.dropped);
+	else
+		log("VFD trace %s: %u bytes, %u records dropped", vfd_trace.enabled ? "on" : "off", (unsigned)vfd_trace.used, (unsigned)vfd_trace.dropped);
+}
+
+void loop_VFD_trace()
+{
+	if (vfd_trace_dump_offset >= 0) {
+		for (int i = 0; i < VFD_TRACE_CHUNKS_PER_LOOP && vfd_trace_dump_offset >= 0; i++)
+			vfd_trace_dump_chunk();
+	}
+	else if (vfd_trace_pending_command.length() > 0) { // Commands during a dump wait for its end
+		String command = vfd_trace_pending_command;
+		vfd_trace_pending_command = "";
+		vfd_trace_command(command);
+	}
+}
+
+#else
+
+void setup_VFD_trace()
+{
+}
+
+void loop_VFD_trace()
+{
+}
+
+void vfd_trace_frame()
+{
+}
+
+#endif
+
 //-----------------------------------------------------------------------------
 // Arduino setup & loop code:
 //-----------------------------------------------------------------------------
@@ -738,6 +1332,7 @@ void setup()
 	Serial.printf("---------------------------------------------------------\n");
 
 	setup_Preferences();
+	setup_telemetry();
 	setup_WIFI();
 	setup_VFD();
 }
@@ -762,18 +1357,30 @@ void loop()
 	}
 
 	loop_VFD();
+	loop_VFD_trace();
 
 	if (sec != last_sec) {
 		last_sec = sec;
 		loop_VFD_1sec();
+		loop_telemetry_1sec();
 
 		// Retry timezone lookup:
 		if (sec == 0 && !timezone_setup_done) {
 			setup_timezone();
+			if (ntp_server_idx >= 0)
+				ntp_send_request(); // The pending answer is stale now, ask again
 		}
 	}
+#if CLOCK_FACE == CLOCK_FACE_ANALOG
+	else if (frame_timer.repeat()) {
+		loop_VFD_1sec(); // Smooth second hand
+	}
+#endif
+
+	loop_telemetry();
 
 	if (alive_timer.repeat()) {
 		mqtt_publish("/status/alive", "true");
+		ntp_publish_status();
 	}
 }
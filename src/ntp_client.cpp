@@ -0,0 +1,133 @@
+#include "ntp_client.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Seconds between 1900-01-01 (NTP era 0) and 1970-01-01:
+#define NTP_UNIX_OFFSET 2208988800ULL
+
+static void write_timestamp(uint8_t *p, int64_t us)
+{
+	uint64_t sec = (uint64_t)(us / 1000000) + NTP_UNIX_OFFSET;
+	uint64_t frac = ((uint64_t)(us % 1000000) << 32) / 1000000;
+
+	p[0] = sec >> 24;
+	p[1] = sec >> 16;
+	p[2] = sec >> 8;
+	p[3] = sec;
+	p[4] = frac >> 24;
+	p[5] = frac >> 16;
+	p[6] = frac >> 8;
+	p[7] = frac;
+}
+
+static int64_t read_timestamp(const uint8_t *p)
+{
+	uint64_t sec = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	uint64_t frac = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+
+	// Era 1 starts 2036-02-07, assume we are not running before 1968:
+	if ((sec & 0x80000000) == 0)
+		sec += 0x100000000ULL;
+
+	return (int64_t)(sec - NTP_UNIX_OFFSET) * 1000000 + (int64_t)((frac * 1000000) >> 32);
+}
+
+void ntp_build_request(uint8_t *packet, int64_t t1_us)
+{
+	memset(packet, 0, NTP_PACKET_SIZE);
+	packet[0] = (0 << 6) | (4 << 3) | 3; // LI = 0, version 4, mode 3 (client)
+	write_timestamp(packet + 40, t1_us);
+}
+
+bool ntp_parse_response(const uint8_t *packet, size_t len, int64_t t1_us, int64_t t4_us, struct ntp_sample *sample)
+{
+	if (len < NTP_PACKET_SIZE)
+		return false;
+
+	int leap = packet[0] >> 6;
+	int mode = packet[0] & 0x07;
+	int stratum = packet[1];
+
+	if (leap == 3 || mode != 4 || stratum == 0 || stratum > 15)
+		return false; // unsynchronized server or kiss-o'-death
+
+	// The server must echo our transmit timestamp, otherwise it's a late or foreign answer:
+	uint8_t origin[8];
+	write_timestamp(origin, t1_us);
+	if (memcmp(packet + 24, origin, sizeof(origin)) != 0)
+		return false;
+
+	static const uint8_t zero[8] = { 0 };
+	if (memcmp(packet + 40, zero, sizeof(zero)) == 0)
+		return false;
+
+	int64_t t2_us = read_timestamp(packet + 32);
+	int64_t t3_us = read_timestamp(packet + 40);
+
+	sample->offset_us = ((t2_us - t1_us) + (t3_us - t4_us)) / 2;
+	sample->delay_us = (t4_us - t1_us) - (t3_us - t2_us);
+	if (sample->delay_us < 0)
+		sample->delay_us = 0;
+
+	return true;
+}
+
+void ntp_round_begin(struct ntp_state *state)
+{
+	state->sample_count = 0;
+}
+
+void ntp_round_add(struct ntp_state *state, const struct ntp_sample *sample)
+{
+	if (state->sample_count < NTP_MAX_SERVERS)
+		state->samples[state->sample_count++] = *sample;
+}
+
+enum ntp_action ntp_round_end(struct ntp_state *state, uint32_t now_ms, int64_t *correction_us)
+{
+	*correction_us = 0;
+
+	// The sample with the shortest round trip has the smallest asymmetry error:
+	const struct ntp_sample *best = NULL;
+	for (int i = 0; i < state->sample_count; i++) {
+		const struct ntp_sample *s = &state->samples[i];
+		if (s->delay_us <= NTP_MAX_DELAY_US && (best == NULL || s->delay_us < best->delay_us))
+			best = s;
+	}
+	if (best == NULL)
+		return NTP_ACTION_NONE;
+
+	// Jitter: RMS distance of all plausible samples to the selected one.
+	int64_t max_delay = best->delay_us * 2 + NTP_DELAY_MARGIN_US;
+	double sum = 0;
+	int used = 0;
+	for (int i = 0; i < state->sample_count; i++) {
+		const struct ntp_sample *s = &state->samples[i];
+		if (s->delay_us > max_delay)
+			continue;
+		double d = (double)(s->offset_us - best->offset_us);
+		sum += d * d;
+		used++;
+	}
+	int64_t round_jitter = (int64_t)sqrt(sum / used);
+
+	bool first = !state->synced;
+	if (first)
+		state->jitter_us = round_jitter;
+	else
+		state->jitter_us += (round_jitter - state->jitter_us) / 4;
+
+	state->synced = true;
+	state->offset_us = best->offset_us;
+	state->delay_us = best->delay_us;
+	state->used_samples = used;
+	state->last_sync_ms = now_ms;
+
+	*correction_us = best->offset_us;
+
+	if (first || llabs(best->offset_us) >= NTP_STEP_THRESHOLD_US)
+		return NTP_ACTION_STEP;
+	return NTP_ACTION_SLEW;
+}
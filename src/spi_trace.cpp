@@ -0,0 +1,151 @@
+#include "spi_trace.h"
+
+#include <string.h>
+
+static uint8_t at(const struct spi_trace *trace, uint32_t pos)
+{
+	return trace->buf[pos % trace->size];
+}
+
+static uint32_t record_size(const struct spi_trace *trace, uint32_t pos)
+{
+	uint8_t first = at(trace, pos);
+	uint8_t type = first >> 5;
+	uint8_t arg = first & 0x1f;
+
+	if (type == SPI_TRACE_DC)
+		return 1;
+	if (type == SPI_TRACE_DATA)
+		return arg != 0 ? 1 + arg : 2 + at(trace, pos + 1);
+
+	uint32_t size = 1;
+	while (at(trace, pos + size++) & 0x80)
+		;
+	return size;
+}
+
+// Drop the oldest records until len bytes are free:
+static bool make_room(struct spi_trace *trace, uint32_t len)
+{
+	if (len > trace->size)
+		return false;
+
+	while (trace->size - trace->used < len) {
+		uint32_t size = record_size(trace, trace->tail);
+		trace->tail = (trace->tail + size) % trace->size;
+		trace->used -= size;
+		trace->dropped++;
+	}
+	return true;
+}
+
+static void put(struct spi_trace *trace, uint8_t value)
+{
+	trace->buf[(trace->tail + trace->used) % trace->size] = value;
+	trace->used++;
+}
+
+void spi_trace_init(struct spi_trace *trace, uint8_t *buf, uint32_t size)
+{
+	trace->buf = buf;
+	trace->size = size;
+	trace->enabled = false;
+	spi_trace_clear(trace);
+}
+
+void spi_trace_clear(struct spi_trace *trace)
+{
+	trace->tail = 0;
+	trace->used = 0;
+	trace->dropped = 0;
+	trace->last_us = 0;
+}
+
+void spi_trace_event(struct spi_trace *trace, uint8_t type, uint8_t arg, uint32_t now_us)
+{
+	if (!trace->enabled)
+		return;
+
+	uint32_t delta = trace->used == 0 ? 0 : now_us - trace->last_us;
+	trace->last_us = now_us;
+
+	uint8_t varint[5];
+	uint32_t len = 0;
+	do {
+		varint[len] = delta & 0x7f;
+		delta >>= 7;
+		if (delta != 0)
+			varint[len] |= 0x80;
+		len++;
+	} while (delta != 0);
+
+	if (!make_room(trace, 1 + len))
+		return;
+	put(trace, (type << 5) | (arg & 0x1f));
+	for (uint32_t i = 0; i < len; i++)
+		put(trace, varint[i]);
+}
+
+void spi_trace_dc(struct spi_trace *trace, uint8_t dc)
+{
+	if (!trace->enabled || !make_room(trace, 1))
+		return;
+	put(trace, (SPI_TRACE_DC << 5) | (dc & 1));
+}
+
+void spi_trace_data(struct spi_trace *trace, const uint8_t *data, uint32_t len)
+{
+	if (!trace->enabled)
+		return;
+
+	while (len > 0) {
+		uint32_t chunk = len > 255 ? 255 : len;
+
+		if (!make_room(trace, chunk + (chunk < 32 ? 1 : 2)))
+			return;
+		if (chunk < 32) {
+			put(trace, (SPI_TRACE_DATA << 5) | chunk);
+		}
+		else {
+			put(trace, SPI_TRACE_DATA << 5);
+			put(trace, chunk);
+		}
+		for (uint32_t i = 0; i < chunk; i++)
+			put(trace, data[i]);
+
+		data += chunk;
+		len -= chunk;
+	}
+}
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+	out[0] = value;
+	out[1] = value >> 8;
+	out[2] = value >> 16;
+	out[3] = value >> 24;
+}
+
+void spi_trace_header(const struct spi_trace *trace, uint32_t spi_hz, uint8_t *out)
+{
+	memcpy(out, "VFDT", 4);
+	out[4] = SPI_TRACE_VERSION;
+	out[5] = 0;
+	out[6] = 0;
+	out[7] = 0;
+	put_u32(out + 8, trace->used);
+	put_u32(out + 12, trace->dropped);
+	put_u32(out + 16, spi_hz);
+}
+
+uint32_t spi_trace_read(const struct spi_trace *trace, uint32_t offset, uint8_t *out, uint32_t len)
+{
+	if (offset >= trace->used)
+		return 0;
+	if (len > trace->used - offset)
+		len = trace->used - offset;
+
+	for (uint32_t i = 0; i < len; i++)
+		out[i] = at(trace, trace->tail + offset + i);
+	return len;
+}
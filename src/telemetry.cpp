@@ -0,0 +1,136 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+struct cbor_writer {
+	uint8_t *out;
+	size_t size;
+	size_t len;
+	bool overflow;
+};
+
+static void cbor_put(struct cbor_writer *w, uint8_t value)
+{
+	if (w->len < w->size)
+		w->out[w->len++] = value;
+	else
+		w->overflow = true;
+}
+
+// Major type with the shortest encoding of value:
+static void cbor_head(struct cbor_writer *w, uint8_t major, uint64_t value)
+{
+	major <<= 5;
+	if (value < 24) {
+		cbor_put(w, major | value);
+		return;
+	}
+
+	int bytes;
+	if (value <= 0xff) {
+		cbor_put(w, major | 24);
+		bytes = 1;
+	}
+	else if (value <= 0xffff) {
+		cbor_put(w, major | 25);
+		bytes = 2;
+	}
+	else if (value <= 0xffffffff) {
+		cbor_put(w, major | 26);
+		bytes = 4;
+	}
+	else {
+		cbor_put(w, major | 27);
+		bytes = 8;
+	}
+	while (bytes-- > 0)
+		cbor_put(w, value >> (8 * bytes));
+}
+
+static void cbor_int(struct cbor_writer *w, int64_t value)
+{
+	if (value >= 0)
+		cbor_head(w, CBOR_UINT, value);
+	else
+		cbor_head(w, CBOR_NEGINT, -1 - value);
+}
+
+static void cbor_text(struct cbor_writer *w, const char *text)
+{
+	size_t len = strlen(text);
+	cbor_head(w, CBOR_TEXT, len);
+	for (size_t i = 0; i < len; i++)
+		cbor_put(w, text[i]);
+}
+
+int telemetry_add_gauge(struct telemetry *telemetry, const char *name)
+{
+	if (telemetry->gauge_count >= TELEMETRY_MAX_GAUGES)
+		return -1;
+
+	int gauge = telemetry->gauge_count++;
+	telemetry->gauges[gauge].name = name;
+	telemetry->gauges[gauge].count = 0;
+	return gauge;
+}
+
+void telemetry_sample(struct telemetry *telemetry, int gauge, int32_t value)
+{
+	if (gauge < 0 || gauge >= telemetry->gauge_count)
+		return;
+
+	struct telemetry_gauge *g = &telemetry->gauges[gauge];
+	if (g->count == 0 || value < g->min)
+		g->min = value;
+	if (g->count == 0 || value > g->max)
+		g->max = value;
+	g->sum = g->count == 0 ? value : g->sum + value;
+	g->count++;
+}
+
+void telemetry_reset(struct telemetry *telemetry)
+{
+	for (int i = 0; i < telemetry->gauge_count; i++)
+		telemetry->gauges[i].count = 0;
+}
+
+size_t telemetry_encode(const struct telemetry *telemetry, uint32_t unix_time, uint32_t window_s, uint8_t *out, size_t size)
+{
+	struct cbor_writer w = { out, size, 0, false };
+
+	int used = 0;
+	for (int i = 0; i < telemetry->gauge_count; i++)
+		if (telemetry->gauges[i].count > 0)
+			used++;
+
+	cbor_head(&w, CBOR_MAP, 4);
+	cbor_text(&w, "v");
+	cbor_int(&w, TELEMETRY_VERSION);
+	cbor_text(&w, "t");
+	cbor_int(&w, unix_time);
+	cbor_text(&w, "w");
+	cbor_int(&w, window_s);
+	cbor_text(&w, "g");
+	cbor_head(&w, CBOR_MAP, used);
+
+	for (int i = 0; i < telemetry->gauge_count; i++) {
+		const struct telemetry_gauge *g = &telemetry->gauges[i];
+		if (g->count == 0)
+			continue;
+
+		cbor_text(&w, g->name);
+		cbor_head(&w, CBOR_ARRAY, 4);
+		cbor_int(&w, g->min);
+		cbor_int(&w, g->max);
+		cbor_int(&w, g->sum / (int64_t)g->count);
+		cbor_int(&w, g->count);
+	}
+
+	return w.overflow ? 0 : w.len;
+}
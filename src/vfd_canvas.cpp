@@ -0,0 +1,84 @@
+#include "vfd_canvas.h"
+
+#include <string.h>
+
+bool vfd_canvas_init(struct vfd_canvas *canvas, int panels, bool horizontal)
+{
+	bool valid = panels >= 1 && panels <= VFD_MAX_PANELS;
+	canvas->panels = valid ? panels : 0;
+	canvas->horizontal = horizontal;
+
+	// The panels are cleared by their begin():
+	memset(canvas->tiles, 0, sizeof(canvas->tiles));
+	memset(canvas->dirty, 0, sizeof(canvas->dirty));
+	return valid;
+}
+
+void vfd_canvas_invalidate(struct vfd_canvas *canvas)
+{
+	memset(canvas->dirty, 0xff, sizeof(canvas->dirty));
+}
+
+void vfd_canvas_draw_tiles(struct vfd_canvas *canvas, uint8_t x, uint8_t y, uint8_t cnt, const uint8_t *ptr)
+{
+	if (y >= VFD_PANEL_TILE_ROWS)
+		return;
+
+	for (int i = 0; i < cnt; i++) {
+		int col = x + i;
+		int panel = col / VFD_PANEL_TILE_COLS;
+		if (panel >= canvas->panels)
+			break;
+		col %= VFD_PANEL_TILE_COLS;
+
+		// Vertical layout: 8 bytes per tile. Horizontal: a byte per pixel row, rows are cnt bytes apart.
+		uint8_t tile[8];
+		for (int row = 0; row < 8; row++)
+			tile[row] = canvas->horizontal ? ptr[row * cnt + i] : ptr[i * 8 + row];
+
+		uint8_t *dest = canvas->tiles[panel][y][col];
+		if (memcmp(dest, tile, sizeof(tile)) != 0) {
+			memcpy(dest, tile, sizeof(tile));
+			canvas->dirty[panel][y] |= 1UL << col;
+		}
+	}
+}
+
+int vfd_canvas_flush(struct vfd_canvas *canvas, vfd_canvas_send_cb send, void *context)
+{
+	uint8_t buf[VFD_PANEL_TILE_COLS * 8];
+	int sent = 0;
+
+	// One pass over the bus, panels without changes are skipped entirely:
+	for (int panel = 0; panel < canvas->panels; panel++) {
+		for (int y = 0; y < VFD_PANEL_TILE_ROWS; y++) {
+			uint32_t dirty = canvas->dirty[panel][y];
+			canvas->dirty[panel][y] = 0;
+
+			int col = 0;
+			while (dirty != 0) {
+				while ((dirty & 1) == 0) {
+					dirty >>= 1;
+					col++;
+				}
+				int start = col;
+				while (dirty & 1) {
+					dirty >>= 1;
+					col++;
+				}
+				int cnt = col - start;
+
+				uint8_t *tiles = canvas->tiles[panel][y][start];
+				if (canvas->horizontal) {
+					for (int i = 0; i < cnt; i++)
+						for (int row = 0; row < 8; row++)
+							buf[row * cnt + i] = tiles[i * 8 + row];
+					tiles = buf;
+				}
+				send(context, panel, start, y, cnt, tiles);
+				sent += cnt;
+			}
+		}
+	}
+	return sent;
+}
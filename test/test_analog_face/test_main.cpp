@@ -0,0 +1,320 @@
+// Analog face geometry: golden images at fixed times and the per frame cost.
+
+#include <unity.h>
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "analog_face.h"
+#include "fixed_trig.h"
+
+#define C DIAL_RADIUS
+
+// Dial and hands rendered with analog_face_line(), '#' = pixel on:
+static const char *const golden_03_00_00[DIAL_SIZE] = {
+	"....................#########....................",
+	"................####.........####................",
+	"..............##......#.#.#..#...##..............",
+	"............##...#.#....#......#...##............",
+	"...........#...#........#........#...#...........",
+	".........##..#..........#..........#..##.........",
+	"........#..#.#..........#.........#..#..#........",
+	".......#......#.........#.........#......#.......",
+	"......#..#....#.........#........#.....#..#......",
+	".....#..#...............#...............#..#.....",
+	".....#..................#..................#.....",
+	"....#.#.................#.................#.#....",
+	"...#....................#....................#...",
+	"...#.#..................#.................##.#...",
+	"..#...##................#...............##....#..",
+	"..#.#...#..............###..................#.#..",
+	".#.....................###.....................#.",
+	".#.#...................###...................#.#.",
+	".#.....................###.....................#.",
+	".##....................###...................#.#.",
+	"#......................###......................#",
+	"#......................###......................#",
+	"#.#....................###....................#.#",
+	"#......................########.................#",
+	"#.####.................###############.....####.#",
+	"#.......................#######.................#",
+	"#.#...........................................#.#",
+	"#...............................................#",
+	"#...............................................#",
+	".#.#..........................................##.",
+	".#.............................................#.",
+	".#.#.........................................#.#.",
+	".#.............................................#.",
+	"..#.#...................................#...#.#..",
+	"..#....##................................##...#..",
+	"...#.##....................................#.#...",
+	"...#.........................................#...",
+	"....#.#...................................#.#....",
+	".....#.....................................#.....",
+	".....#..#...............................#..#.....",
+	"......#..#.....#..................#....#..#......",
+	".......#......#...................#......#.......",
+	"........#..#..#....................#.#..#........",
+	".........##..#..........#..........#..##.........",
+	"...........#...#........#........#...#...........",
+	"............##...#......#....#.#...##............",
+	"..............##...#..#.#.#......##..............",
+	"................####.........####................",
+	"....................#########....................",
+};
+
+// 10:10:30.500, the second hand is half a second past 6:
+static const char *const golden_10_10_30_500[DIAL_SIZE] = {
+	"....................#########....................",
+	"................####.........####................",
+	"..............##......#.#.#..#...##..............",
+	"............##...#.#....#......#...##............",
+	"...........#...#........#........#...#...........",
+	".........##..#..........#..........#..##.........",
+	"........#..#.#....................#..#..#........",
+	".......#......#...................#......#.......",
+	"......#..#....#..................#.....#..#......",
+	".....#..#...............................#..#.....",
+	".....#.....................................#.....",
+	"....#.#...................................#.#....",
+	"...#.........................................#...",
+	"...#.#....................................##.#...",
+	"..#...##................................##....#..",
+	"..#.#...#...............................##..#.#..",
+	".#....................................###......#.",
+	".#.#.........##.....................###......#.#.",
+	".#............###.................###..........#.",
+	".##............####.............####.........#.#.",
+	"#................####.........####..............#",
+	"#.................#####.....####................#",
+	"#.#................#.#.##.####................#.#",
+	"#...................#########...................#",
+	"#.####................#.###................####.#",
+	"#......................##.......................#",
+	"#.#.....................#.....................#.#",
+	"#.......................#.......................#",
+	"#.......................#.......................#",
+	".#.#....................#.....................##.",
+	".#......................#......................#.",
+	".#.#....................#....................#.#.",
+	".#......................#......................#.",
+	"..#.#...................#...............#...#.#..",
+	"..#....##...............#................##...#..",
+	"...#.##................#...................#.#...",
+	"...#...................#.....................#...",
+	"....#.#................#..................#.#....",
+	".....#.................#...................#.....",
+	".....#..#..............#................#..#.....",
+	"......#..#.....#.......#..........#....#..#......",
+	".......#......#........#..........#......#.......",
+	"........#..#..#........#...........#.#..#........",
+	".........##..#.........##..........#..##.........",
+	"...........#...#.......##........#...#...........",
+	"............##...#.....##....#.#...##............",
+	"..............##...#..###.#......##..............",
+	"................####.........####................",
+	"....................#########....................",
+};
+
+static void bitmap_line(void *context, int x0, int y0, int x1, int y1)
+{
+	analog_face_line((uint8_t *)context, x0, y0, x1, y1);
+}
+
+static void render(uint8_t *bitmap, int hour, int min, int sec, int ms)
+{
+	struct tm now = {};
+	now.tm_hour = hour;
+	now.tm_min = min;
+	now.tm_sec = sec;
+
+	struct analog_hands hands;
+	analog_face_hands(&now, ms, &hands);
+	analog_face_build_dial(bitmap);
+	analog_face_draw_hand(C, C, &hands.hour, bitmap_line, bitmap);
+	analog_face_draw_hand(C, C, &hands.minute, bitmap_line, bitmap);
+	analog_face_draw_hand(C, C, &hands.second, bitmap_line, bitmap);
+}
+
+static void check_golden(const char *const *golden, const uint8_t *bitmap)
+{
+	for (int y = 0; y < DIAL_SIZE; y++) {
+		char row[DIAL_SIZE + 1];
+		for (int x = 0; x < DIAL_SIZE; x++)
+			row[x] = (bitmap[y * DIAL_BYTES_PER_ROW + (x >> 3)] >> (x & 7)) & 1 ? '#' : '.';
+		row[DIAL_SIZE] = 0;
+		TEST_ASSERT_EQUAL_STRING(golden[y], row);
+	}
+}
+
+// End point of a hand:
+static void hand_end(const struct analog_hand *hand, int *x, int *y)
+{
+	*x = C + fx_mul(hand->length, fx_sin(hand->angle));
+	*y = C - fx_mul(hand->length, fx_cos(hand->angle));
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_fixed_trig()
+{
+	for (int angle = -FX_ANGLE_STEPS; angle < 2 * FX_ANGLE_STEPS; angle++) {
+		double rad = angle * 2 * M_PI / FX_ANGLE_STEPS;
+		TEST_ASSERT_INT_WITHIN(1, (int)lround(sin(rad) * FX_ONE), fx_sin(angle));
+		TEST_ASSERT_INT_WITHIN(1, (int)lround(cos(rad) * FX_ONE), fx_cos(angle));
+	}
+	TEST_ASSERT_EQUAL(-12, fx_mul(-12, FX_ONE));
+	TEST_ASSERT_EQUAL(5, fx_mul(10, FX_HALF));
+}
+
+void test_golden_images()
+{
+	static uint8_t bitmap[DIAL_BYTES_PER_ROW * DIAL_SIZE];
+
+	render(bitmap, 3, 0, 0, 0);
+	check_golden(golden_03_00_00, bitmap);
+	render(bitmap, 22, 10, 30, 500); // 12h dial
+	check_golden(golden_10_10_30_500, bitmap);
+}
+
+void test_hand_positions()
+{
+	struct tm now = {};
+	struct analog_hands hands;
+	int x, y;
+
+	now.tm_hour = 3;
+	analog_face_hands(&now, 0, &hands);
+	hand_end(&hands.hour, &x, &y);
+	TEST_ASSERT_EQUAL(C + hands.hour.length, x); // 3 o'clock: right
+	TEST_ASSERT_EQUAL(C, y);
+	hand_end(&hands.minute, &x, &y);
+	TEST_ASSERT_EQUAL(C, x); // :00: up
+	TEST_ASSERT_EQUAL(C - hands.minute.length, y);
+
+	now.tm_hour = 6;
+	now.tm_min = 30;
+	analog_face_hands(&now, 0, &hands);
+	hand_end(&hands.minute, &x, &y);
+	TEST_ASSERT_EQUAL(C, x); // :30: down
+	TEST_ASSERT_EQUAL(C + hands.minute.length, y);
+	TEST_ASSERT_EQUAL(FX_ANGLE_STEPS / 2 + FX_ANGLE_STEPS / 24, hands.hour.angle); // Half way to 7
+
+	// The second hand moves between the seconds, the others don't:
+	now.tm_sec = 15;
+	analog_face_hands(&now, 0, &hands);
+	struct analog_hands later;
+	analog_face_hands(&now, 500, &later);
+	TEST_ASSERT_EQUAL(FX_ANGLE_STEPS / 4, hands.second.angle);
+	TEST_ASSERT_TRUE(later.second.angle > hands.second.angle);
+	TEST_ASSERT_EQUAL(hands.minute.angle, later.minute.angle);
+	TEST_ASSERT_EQUAL(hands.hour.angle, later.hour.angle);
+}
+
+void test_hands_inside_dial()
+{
+	struct tm now = {};
+	for (int sec = 0; sec < 12 * 3600; sec += 7) {
+		now.tm_hour = sec / 3600;
+		now.tm_min = sec / 60 % 60;
+		now.tm_sec = sec % 60;
+
+		struct analog_hands hands;
+		analog_face_hands(&now, 999, &hands);
+		const struct analog_hand *all[] = { &hands.hour, &hands.minute, &hands.second };
+		for (const struct analog_hand *hand : all) {
+			TEST_ASSERT_TRUE(hand->angle >= 0 && hand->angle < FX_ANGLE_STEPS);
+			int x, y;
+			hand_end(hand, &x, &y);
+			int dx = x - C, dy = y - C;
+			TEST_ASSERT_TRUE(dx * dx + dy * dy <= (DIAL_RADIUS - 1) * (DIAL_RADIUS - 1));
+		}
+	}
+}
+
+// One u8g2 page (8 rows), lines are clipped to it like u8g2_DrawLine() does:
+struct page {
+	uint8_t pixels[8][DIAL_SIZE];
+	int top;
+};
+
+static void page_line(void *context, int x0, int y0, int x1, int y1)
+{
+	struct page *p = (struct page *)context;
+	int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+	int dy = -(y1 > y0 ? y1 - y0 : y0 - y1);
+	int sx = x0 < x1 ? 1 : -1;
+	int sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	for (;;) {
+		if (y0 >= p->top && y0 < p->top + 8)
+			p->pixels[y0 - p->top][x0] = 1;
+		if (x0 == x1 && y0 == y1)
+			break;
+		int e2 = 2 * err;
+		if (e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+// A minute at 25 fps, each frame drawn page by page like loop_VFD_1sec():
+void test_frame_rate()
+{
+	static uint8_t dial[DIAL_BYTES_PER_ROW * DIAL_SIZE];
+	static struct page page;
+	analog_face_build_dial(dial);
+
+	const int frames = 60 * 25;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		struct tm now = {};
+		now.tm_hour = 10;
+		now.tm_min = 10;
+		now.tm_sec = frame / 25;
+
+		struct analog_hands hands;
+		analog_face_hands(&now, frame % 25 * 40, &hands);
+		for (page.top = 0; page.top < 56; page.top += 8) {
+			memset(page.pixels, 0, sizeof(page.pixels));
+			for (int y = page.top; y < page.top + 8 && y < DIAL_SIZE; y++) // drawXBM()
+				for (int x = 0; x < DIAL_SIZE; x++)
+					if ((dial[y * DIAL_BYTES_PER_ROW + (x >> 3)] >> (x & 7)) & 1)
+						page.pixels[y - page.top][x] = 1;
+			analog_face_draw_hand(C, C, &hands.hour, page_line, &page);
+			analog_face_draw_hand(C, C, &hands.minute, page_line, &page);
+			analog_face_draw_hand(C, C, &hands.second, page_line, &page);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double us = std::chrono::duration<double, std::micro>(end - start).count() / frames;
+	char buf[100];
+	snprintf(buf, sizeof(buf), "analog face: %.2f us per frame (7 pages), %.0f fps possible on the host", us, 1e6 / us);
+	TEST_MESSAGE(buf);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_fixed_trig);
+	RUN_TEST(test_golden_images);
+	RUN_TEST(test_hand_positions);
+	RUN_TEST(test_hands_inside_dial);
+	RUN_TEST(test_frame_rate);
+	return UNITY_END();
+}
@@ -0,0 +1,272 @@
+// Font subsets against the complete u8g2 fonts they were generated from.
+// Needs -D FONT_SUBSET_REFERENCE (see [env:native] in platformio.ini).
+
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "font_subset.h"
+
+#define PAGE_ROWS 8
+#define PAGES 7
+#define WIDTH 256
+#define HEIGHT (PAGE_ROWS * PAGES)
+
+// Page mode frame like U8G2_..._1_, the hline callback clips to the page like u8g2:
+struct frame {
+	uint8_t pixels[HEIGHT][WIDTH];
+	int page_top;
+};
+
+static void frame_hline(void *context, int x, int y, int len)
+{
+	struct frame *f = (struct frame *)context;
+	if (y < f->page_top || y >= f->page_top + PAGE_ROWS)
+		return;
+	for (; len > 0; len--, x++)
+		if (x >= 0 && x < WIDTH)
+			f->pixels[y][x] = 1;
+}
+
+//-----------------------------------------------------------------------------
+// Reference: glyph lookup and RLE decoding as done by u8g2 (u8g2_font.c)
+//-----------------------------------------------------------------------------
+
+struct bit_reader {
+	const uint8_t *p;
+	int bit;
+};
+
+static unsigned read_unsigned(struct bit_reader *r, int cnt)
+{
+	unsigned val = *r->p >> r->bit;
+	int bit = r->bit + cnt;
+	if (bit >= 8) {
+		r->p++;
+		val |= (unsigned)*r->p << (8 - r->bit);
+		bit -= 8;
+	}
+	r->bit = bit;
+	return val & ((1U << cnt) - 1);
+}
+
+static int read_signed(struct bit_reader *r, int cnt)
+{
+	return (int)read_unsigned(r, cnt) - (1 << (cnt - 1));
+}
+
+static const uint8_t *reference_glyph(const uint8_t *font, uint16_t code)
+{
+	const uint8_t *p = font + 23;
+	if (code >= 'a')
+		p += (font[19] << 8) | font[20];
+	else if (code >= 'A')
+		p += (font[17] << 8) | font[18];
+
+	for (; p[1] != 0; p += p[1])
+		if (p[0] == code)
+			return p + 2;
+	return NULL;
+}
+
+// Draws the glyph at x/y (baseline) via hline, returns the advance.
+static int reference_draw(const uint8_t *font, const uint8_t *data, int x, int y, int clip_top, int clip_bottom, subset_hline_cb hline, void *context)
+{
+	struct bit_reader r = { data, 0 };
+	int w = read_unsigned(&r, font[4]);
+	int h = read_unsigned(&r, font[5]);
+	int x_offset = read_signed(&r, font[6]);
+	int y_offset = read_signed(&r, font[7]);
+	int advance = read_signed(&r, font[8]);
+
+	x += x_offset;
+	y -= h + y_offset;
+	if (w == 0 || y >= clip_bottom || y + h <= clip_top) // u8g2_IsIntersection()
+		return advance;
+
+	int lx = 0, ly = 0;
+	while (ly < h) {
+		int zeros = read_unsigned(&r, font[2]);
+		int ones = read_unsigned(&r, font[3]);
+		do {
+			for (int pass = 0; pass < 2; pass++) {
+				int cnt = pass == 0 ? zeros : ones;
+				while (cnt > 0) {
+					int current = cnt < w - lx ? cnt : w - lx;
+					if (pass == 1)
+						hline(context, x + lx, y + ly, current);
+					cnt -= current;
+					lx += current;
+					if (lx == w) {
+						lx = 0;
+						ly++;
+					}
+				}
+			}
+		} while (read_unsigned(&r, 1) != 0);
+	}
+	return advance;
+}
+
+//-----------------------------------------------------------------------------
+
+static struct frame frame_a, frame_b;
+
+static void render_reference(struct frame *f, const struct subset_reference *ref, const char *text)
+{
+	memset(f, 0, sizeof(*f));
+	for (f->page_top = 0; f->page_top < HEIGHT; f->page_top += PAGE_ROWS) {
+		int x = 0;
+		const char *p = text;
+		uint16_t code;
+		while ((code = utf8_next(&p)) != 0) {
+			const uint8_t *data = reference_glyph(ref->u8g2_font, code);
+			if (data != NULL)
+				x += reference_draw(ref->u8g2_font, data, x, 20, f->page_top, f->page_top + PAGE_ROWS, frame_hline, f);
+		}
+	}
+}
+
+static void render_subset(struct frame *f, const struct subset_reference *ref, const char *text, bool page_check)
+{
+	memset(f, 0, sizeof(*f));
+	for (f->page_top = 0; f->page_top < HEIGHT; f->page_top += PAGE_ROWS) {
+		int x = 0;
+		const char *p = text;
+		uint16_t code;
+		while ((code = utf8_next(&p)) != 0) {
+			const struct subset_glyph *glyph = subset_font_glyph(ref->subset, code);
+			if (glyph == NULL)
+				continue;
+			if (page_check)
+				subset_draw_glyph(ref->subset, glyph, x, 20, f->page_top, f->page_top + PAGE_ROWS, frame_hline, f);
+			else
+				subset_draw_glyph(ref->subset, glyph, x, 20, -32768, 32767, frame_hline, f);
+			x += glyph->advance;
+		}
+	}
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_utf8()
+{
+	const char *text = "M\xc3\xa4rz \xe2\x82\xac!";
+	TEST_ASSERT_EQUAL_HEX16('M', utf8_next(&text));
+	TEST_ASSERT_EQUAL_HEX16(0xe4, utf8_next(&text));
+	TEST_ASSERT_EQUAL_HEX16('r', utf8_next(&text));
+	TEST_ASSERT_EQUAL_HEX16('z', utf8_next(&text));
+	TEST_ASSERT_EQUAL_HEX16(' ', utf8_next(&text));
+	TEST_ASSERT_EQUAL_HEX16(0xfffd, utf8_next(&text)); // 3 byte sequence, not in the fonts
+	TEST_ASSERT_EQUAL_HEX16('!', utf8_next(&text));
+	TEST_ASSERT_EQUAL_HEX16(0, utf8_next(&text));
+}
+
+void test_subset_has_all_glyphs()
+{
+	for (int i = 0; i < font_subset_reference_count; i++) {
+		const struct subset_reference *ref = &font_subset_references[i];
+		for (const char *const *t = ref->texts; *t != NULL; t++) {
+			const char *p = *t;
+			uint16_t code;
+			while ((code = utf8_next(&p)) != 0) {
+				TEST_ASSERT_NOT_NULL_MESSAGE(reference_glyph(ref->u8g2_font, code), ref->u8g2_name);
+				TEST_ASSERT_NOT_NULL_MESSAGE(subset_font_glyph(ref->subset, code), *t);
+			}
+		}
+	}
+}
+
+void test_subset_renders_like_u8g2()
+{
+	for (int i = 0; i < font_subset_reference_count; i++) {
+		const struct subset_reference *ref = &font_subset_references[i];
+		for (const char *const *t = ref->texts; *t != NULL; t++) {
+			render_reference(&frame_a, ref, *t);
+			render_subset(&frame_b, ref, *t, true);
+			TEST_ASSERT_EQUAL_MEMORY_MESSAGE(frame_a.pixels, frame_b.pixels, sizeof(frame_a.pixels), *t);
+			render_subset(&frame_b, ref, *t, false);
+			TEST_ASSERT_EQUAL_MEMORY_MESSAGE(frame_a.pixels, frame_b.pixels, sizeof(frame_a.pixels), *t);
+		}
+	}
+}
+
+void test_page_clip()
+{
+	const struct subset_reference *ref = &font_subset_references[0];
+	const struct subset_glyph *glyph = subset_font_glyph(ref->subset, ref->texts[0][0]);
+	TEST_ASSERT_NOT_NULL(glyph);
+
+	// Page above/below the glyph: nothing drawn
+	memset(&frame_a, 0, sizeof(frame_a));
+	frame_a.page_top = 0;
+	subset_draw_glyph(ref->subset, glyph, 0, 40, 0, 8, frame_hline, &frame_a);
+	frame_a.page_top = 48;
+	subset_draw_glyph(ref->subset, glyph, 0, 20, 48, 56, frame_hline, &frame_a);
+	static const uint8_t empty[HEIGHT][WIDTH] = {};
+	TEST_ASSERT_EQUAL_MEMORY(empty, frame_a.pixels, sizeof(empty));
+}
+
+typedef void (*render_fn)(const struct subset_reference *ref, const char *text);
+
+static void bench_reference(const struct subset_reference *ref, const char *text)
+{
+	render_reference(&frame_a, ref, text);
+}
+
+static void bench_subset_unclipped(const struct subset_reference *ref, const char *text)
+{
+	render_subset(&frame_a, ref, text, false);
+}
+
+static void bench_subset(const struct subset_reference *ref, const char *text)
+{
+	render_subset(&frame_a, ref, text, true);
+}
+
+// All texts of all subsets (EN + DE week days and months, numbers, ...) drawn page by page:
+static double bench(render_fn render)
+{
+	const int rounds = 200;
+	int frames = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int n = 0; n < rounds; n++) {
+		for (int i = 0; i < font_subset_reference_count; i++) {
+			const struct subset_reference *ref = &font_subset_references[i];
+			for (const char *const *t = ref->texts; *t != NULL; t++, frames++)
+				render(ref, *t);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / frames;
+}
+
+void test_benchmark()
+{
+	double reference = bench(bench_reference);
+	double unclipped = bench(bench_subset_unclipped);
+	double clipped = bench(bench_subset);
+
+	char buf[160];
+	snprintf(buf, sizeof(buf), "ns per text (7 pages): u8g2 lookup+RLE %.0f, subset %.0f, subset+page check %.0f", reference, unclipped, clipped);
+	TEST_MESSAGE(buf);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_utf8);
+	RUN_TEST(test_subset_has_all_glyphs);
+	RUN_TEST(test_subset_renders_like_u8g2);
+	RUN_TEST(test_page_clip);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
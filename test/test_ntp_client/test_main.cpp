@@ -0,0 +1,262 @@
+// SNTP client logic against local UDP NTP stand-ins with artificial delay and jitter.
+
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <random>
+#include <string.h>
+#include <thread>
+
+#include "ntp_client.h"
+
+static int64_t now_us()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void sleep_us(int64_t us)
+{
+	if (us > 0)
+		usleep(us);
+}
+
+// Same encoding as the server side of RFC 4330:
+static void put_timestamp(uint8_t *p, int64_t us)
+{
+	uint64_t sec = (uint64_t)(us / 1000000) + 2208988800ULL;
+	uint64_t frac = ((uint64_t)(us % 1000000) << 32) / 1000000;
+	for (int i = 0; i < 4; i++) {
+		p[i] = sec >> (24 - 8 * i);
+		p[4 + i] = frac >> (24 - 8 * i);
+	}
+}
+
+struct stand_in {
+	int64_t offset_us; // Server clock - local clock
+	int64_t delay_in_us; // Client -> server
+	int64_t delay_out_us; // Server -> client
+	int64_t jitter_us; // Added randomly to both directions
+	int stratum;
+
+	int fd;
+	uint16_t port;
+	std::atomic<bool> running;
+	std::thread thread;
+};
+
+static void stand_in_run(struct stand_in *s)
+{
+	std::mt19937 rnd(s->port);
+	std::uniform_int_distribution<int64_t> jitter(0, s->jitter_us);
+
+	while (s->running) {
+		struct pollfd pfd = { s->fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 20) <= 0)
+			continue;
+
+		uint8_t packet[NTP_PACKET_SIZE];
+		struct sockaddr_in from;
+		socklen_t from_len = sizeof(from);
+		if (recvfrom(s->fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len) != NTP_PACKET_SIZE)
+			continue;
+
+		// The request "arrives" after the inbound delay:
+		sleep_us(s->delay_in_us + jitter(rnd));
+		uint8_t answer[NTP_PACKET_SIZE] = { 0 };
+		answer[0] = (0 << 6) | (4 << 3) | 4;
+		answer[1] = s->stratum;
+		memcpy(answer + 24, packet + 40, 8); // Originate = client transmit
+		put_timestamp(answer + 32, now_us() + s->offset_us);
+		put_timestamp(answer + 40, now_us() + s->offset_us);
+
+		sleep_us(s->delay_out_us + jitter(rnd));
+		sendto(s->fd, answer, sizeof(answer), 0, (struct sockaddr *)&from, from_len);
+	}
+}
+
+static void stand_in_start(struct stand_in *s, int64_t offset_us, int64_t delay_in_us, int64_t delay_out_us, int64_t jitter_us, int stratum)
+{
+	s->offset_us = offset_us;
+	s->delay_in_us = delay_in_us;
+	s->delay_out_us = delay_out_us;
+	s->jitter_us = jitter_us;
+	s->stratum = stratum;
+
+	s->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	bind(s->fd, (struct sockaddr *)&addr, sizeof(addr));
+	socklen_t len = sizeof(addr);
+	getsockname(s->fd, (struct sockaddr *)&addr, &len);
+	s->port = ntohs(addr.sin_port);
+
+	s->running = true;
+	s->thread = std::thread(stand_in_run, s);
+}
+
+static void stand_in_stop(struct stand_in *s)
+{
+	s->running = false;
+	s->thread.join();
+	close(s->fd);
+}
+
+// One request/answer like loop_NTP(), false on timeout or invalid answer:
+static bool query(uint16_t port, struct ntp_sample *sample)
+{
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	uint8_t packet[NTP_PACKET_SIZE];
+	int64_t t1 = now_us();
+	ntp_build_request(packet, t1);
+	sendto(fd, packet, sizeof(packet), 0, (struct sockaddr *)&addr, sizeof(addr));
+
+	bool ok = false;
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	if (poll(&pfd, 1, 1000) > 0) {
+		ssize_t len = recv(fd, packet, sizeof(packet), 0);
+		ok = ntp_parse_response(packet, len, t1, now_us(), sample);
+	}
+	close(fd);
+	return ok;
+}
+
+static enum ntp_action round_with(struct ntp_state *state, struct stand_in **servers, int count, int64_t *correction)
+{
+	ntp_round_begin(state);
+	for (int i = 0; i < count; i++) {
+		struct ntp_sample sample;
+		if (query(servers[i]->port, &sample))
+			ntp_round_add(state, &sample);
+	}
+	return ntp_round_end(state, 0, correction);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_request_layout()
+{
+	uint8_t packet[NTP_PACKET_SIZE];
+	ntp_build_request(packet, 1760000000123456LL);
+
+	TEST_ASSERT_EQUAL_HEX8(0x23, packet[0]); // LI 0, version 4, client
+	for (int i = 1; i < 40; i++)
+		TEST_ASSERT_EQUAL_HEX8(0, packet[i]);
+}
+
+void test_rejects_invalid_answers()
+{
+	int64_t t1 = 1760000000000000LL;
+	uint8_t request[NTP_PACKET_SIZE];
+	ntp_build_request(request, t1);
+
+	uint8_t answer[NTP_PACKET_SIZE] = { 0 };
+	answer[0] = (4 << 3) | 4;
+	answer[1] = 2;
+	memcpy(answer + 24, request + 40, 8);
+	put_timestamp(answer + 32, t1 + 1000);
+	put_timestamp(answer + 40, t1 + 1000);
+
+	struct ntp_sample sample;
+	TEST_ASSERT_TRUE(ntp_parse_response(answer, sizeof(answer), t1, t1 + 2000, &sample));
+	TEST_ASSERT_INT64_WITHIN(1, 0, sample.offset_us);
+	TEST_ASSERT_INT64_WITHIN(1, 2000, sample.delay_us);
+
+	TEST_ASSERT_FALSE(ntp_parse_response(answer, sizeof(answer) - 1, t1, t1 + 2000, &sample));
+	TEST_ASSERT_FALSE(ntp_parse_response(answer, sizeof(answer), t1 + 1, t1 + 2000, &sample)); // Other origin
+
+	answer[1] = 0; // Kiss-o'-death
+	TEST_ASSERT_FALSE(ntp_parse_response(answer, sizeof(answer), t1, t1 + 2000, &sample));
+	answer[1] = 2;
+	answer[0] |= 3 << 6; // Unsynchronized
+	TEST_ASSERT_FALSE(ntp_parse_response(answer, sizeof(answer), t1, t1 + 2000, &sample));
+}
+
+void test_filter_prefers_short_round_trip()
+{
+	// Same true offset, but B's answer is delayed 60 ms on the way back (asymmetric = 30 ms error)
+	// and C has up to 40 ms random jitter in both directions.
+	struct stand_in a, b, c;
+	struct stand_in *servers[] = { &b, &c, &a };
+	stand_in_start(&a, 250000, 2000, 2000, 0, 2);
+	stand_in_start(&b, 250000, 2000, 60000, 0, 2);
+	stand_in_start(&c, 250000, 2000, 2000, 40000, 2);
+
+	struct ntp_state state = {};
+	int64_t correction;
+
+	TEST_ASSERT_EQUAL(NTP_ACTION_STEP, round_with(&state, servers, 3, &correction)); // First sync steps
+	for (int round = 0; round < 4; round++) {
+		enum ntp_action action = round_with(&state, servers, 3, &correction);
+		TEST_ASSERT_EQUAL(NTP_ACTION_SLEW, action);
+		TEST_ASSERT_INT64_WITHIN(3000, 250000, correction);
+		TEST_ASSERT_LESS_THAN(20000, state.delay_us);
+		TEST_ASSERT_LESS_THAN(3, state.used_samples); // B is never within the delay window
+	}
+	TEST_ASSERT_LESS_THAN(25000, state.jitter_us);
+
+	stand_in_stop(&a);
+	stand_in_stop(&b);
+	stand_in_stop(&c);
+}
+
+void test_large_offset_steps()
+{
+	struct stand_in a;
+	struct stand_in *servers[] = { &a };
+	stand_in_start(&a, 5000000, 1000, 1000, 0, 1);
+
+	struct ntp_state state = {};
+	int64_t correction;
+	round_with(&state, servers, 1, &correction);
+	TEST_ASSERT_EQUAL(NTP_ACTION_STEP, round_with(&state, servers, 1, &correction));
+	TEST_ASSERT_INT64_WITHIN(3000, 5000000, correction);
+
+	stand_in_stop(&a);
+}
+
+void test_unsynchronized_server_is_ignored()
+{
+	struct stand_in a;
+	struct stand_in *servers[] = { &a };
+	stand_in_start(&a, 250000, 1000, 1000, 0, 0); // Stratum 0
+
+	struct ntp_state state = {};
+	int64_t correction;
+	TEST_ASSERT_EQUAL(NTP_ACTION_NONE, round_with(&state, servers, 1, &correction));
+	TEST_ASSERT_FALSE(state.synced);
+
+	stand_in_stop(&a);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_request_layout);
+	RUN_TEST(test_rejects_invalid_answers);
+	RUN_TEST(test_filter_prefers_short_round_trip);
+	RUN_TEST(test_large_offset_steps);
+	RUN_TEST(test_unsynchronized_server_is_ignored);
+	return UNITY_END();
+}
@@ -0,0 +1,157 @@
+// SPI trace recorder: record format, ring buffer wrap and drop, dump header.
+
+#include <unity.h>
+
+#include <string.h>
+
+#include "spi_trace.h"
+
+static uint8_t buf[64];
+static struct spi_trace trace;
+
+static uint32_t read_all(uint8_t *out, uint32_t size)
+{
+	return spi_trace_read(&trace, 0, out, size);
+}
+
+void setUp()
+{
+	memset(buf, 0xee, sizeof(buf));
+	spi_trace_init(&trace, buf, sizeof(buf));
+	trace.enabled = true;
+}
+
+void tearDown()
+{
+}
+
+void test_disabled_records_nothing()
+{
+	trace.enabled = false;
+	spi_trace_event(&trace, SPI_TRACE_START, 0, 10);
+	spi_trace_dc(&trace, 1);
+	spi_trace_data(&trace, (const uint8_t *)"abc", 3);
+	TEST_ASSERT_EQUAL(0, trace.used);
+}
+
+void test_record_format()
+{
+	spi_trace_event(&trace, SPI_TRACE_FRAME, 0, 1000);
+	spi_trace_event(&trace, SPI_TRACE_START, 1, 1300); // panel 1, delta 300 = 2 byte varint
+	spi_trace_dc(&trace, 0);
+	spi_trace_data(&trace, (const uint8_t *)"\xf0\x08", 2);
+	spi_trace_event(&trace, SPI_TRACE_END, 0, 1305);
+
+	static const uint8_t expected[] = {
+		SPI_TRACE_FRAME << 5, 0, // first delta is 0
+		SPI_TRACE_START << 5 | 1, 0xac, 0x02, // 300
+		SPI_TRACE_DC << 5 | 0,
+		SPI_TRACE_DATA << 5 | 2, 0xf0, 0x08,
+		SPI_TRACE_END << 5, 5,
+	};
+	uint8_t out[64];
+	TEST_ASSERT_EQUAL(sizeof(expected), read_all(out, sizeof(out)));
+	TEST_ASSERT_EQUAL_MEMORY(expected, out, sizeof(expected));
+}
+
+void test_long_data_gets_length_byte()
+{
+	static uint8_t big[300];
+	static uint8_t large_buf[400];
+	for (int i = 0; i < 300; i++)
+		big[i] = i;
+	spi_trace_init(&trace, large_buf, sizeof(large_buf));
+	trace.enabled = true;
+
+	spi_trace_data(&trace, big, sizeof(big)); // 255 + 45 bytes
+
+	uint8_t out[400];
+	TEST_ASSERT_EQUAL(2 + 255 + 2 + 45, read_all(out, sizeof(out)));
+	TEST_ASSERT_EQUAL_HEX8(SPI_TRACE_DATA << 5, out[0]);
+	TEST_ASSERT_EQUAL(255, out[1]);
+	TEST_ASSERT_EQUAL_MEMORY(big, out + 2, 255);
+	TEST_ASSERT_EQUAL_HEX8(SPI_TRACE_DATA << 5, out[257]);
+	TEST_ASSERT_EQUAL(45, out[258]);
+	TEST_ASSERT_EQUAL_MEMORY(big + 255, out + 259, 45);
+}
+
+void test_full_buffer_drops_oldest_records()
+{
+	// 10 records of 6 bytes (DATA with 5 bytes) into 64 bytes:
+	for (uint8_t i = 0; i < 10; i++) {
+		uint8_t data[5] = { i, i, i, i, i };
+		spi_trace_data(&trace, data, sizeof(data));
+	}
+	TEST_ASSERT_EQUAL(10 * 6, trace.used);
+	TEST_ASSERT_EQUAL(0, trace.dropped);
+
+	// 2 more wrap around and replace the first 2:
+	for (uint8_t i = 10; i < 12; i++) {
+		uint8_t data[5] = { i, i, i, i, i };
+		spi_trace_data(&trace, data, sizeof(data));
+	}
+	TEST_ASSERT_EQUAL(2, trace.dropped);
+	TEST_ASSERT_EQUAL(10 * 6, trace.used);
+
+	// Records come out oldest first and complete:
+	uint8_t out[64];
+	TEST_ASSERT_EQUAL(60, read_all(out, sizeof(out)));
+	for (int i = 0; i < 10; i++) {
+		TEST_ASSERT_EQUAL_HEX8(SPI_TRACE_DATA << 5 | 5, out[i * 6]);
+		TEST_ASSERT_EQUAL(i + 2, out[i * 6 + 1]);
+		TEST_ASSERT_EQUAL(i + 2, out[i * 6 + 5]);
+	}
+}
+
+void test_record_larger_than_buffer_is_skipped()
+{
+	static uint8_t big[100];
+	spi_trace_event(&trace, SPI_TRACE_FRAME, 0, 0);
+	spi_trace_data(&trace, big, sizeof(big));
+	TEST_ASSERT_EQUAL(2, trace.used);
+	TEST_ASSERT_EQUAL(0, trace.dropped);
+}
+
+void test_read_in_chunks()
+{
+	for (uint8_t i = 0; i < 12; i++)
+		spi_trace_data(&trace, &i, 1);
+
+	uint8_t whole[64], chunked[64];
+	uint32_t len = read_all(whole, sizeof(whole));
+	uint32_t offset = 0, n;
+	while ((n = spi_trace_read(&trace, offset, chunked + offset, 7)) > 0)
+		offset += n;
+	TEST_ASSERT_EQUAL(len, offset);
+	TEST_ASSERT_EQUAL_MEMORY(whole, chunked, len);
+}
+
+void test_header()
+{
+	spi_trace_data(&trace, (const uint8_t *)"x", 1);
+	trace.dropped = 3;
+
+	uint8_t header[SPI_TRACE_HEADER_SIZE];
+	spi_trace_header(&trace, 4000000, header);
+
+	static const uint8_t expected[SPI_TRACE_HEADER_SIZE] = {
+		'V', 'F', 'D', 'T', SPI_TRACE_VERSION, 0, 0, 0,
+		2, 0, 0, 0, // used
+		3, 0, 0, 0, // dropped
+		0x00, 0x09, 0x3d, 0x00, // 4 MHz
+	};
+	TEST_ASSERT_EQUAL_MEMORY(expected, header, sizeof(expected));
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_disabled_records_nothing);
+	RUN_TEST(test_record_format);
+	RUN_TEST(test_long_data_gets_length_byte);
+	RUN_TEST(test_full_buffer_drops_oldest_records);
+	RUN_TEST(test_record_larger_than_buffer_is_skipped);
+	RUN_TEST(test_read_in_chunks);
+	RUN_TEST(test_header);
+	return UNITY_END();
+}
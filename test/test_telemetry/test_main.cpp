@@ -0,0 +1,212 @@
+// Telemetry aggregation and its CBOR encoding, plus encode cost and payload size.
+
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+static struct telemetry telemetry;
+
+void setUp()
+{
+	memset(&telemetry, 0, sizeof(telemetry));
+}
+
+void tearDown()
+{
+}
+
+// { "v": 1, "t": unix_time, "w": 300, "g": { ...
+static const uint8_t head[] = {
+	0xa4,
+	0x61, 'v', 0x01,
+	0x61, 't', 0x1a, 0x68, 0xf2, 0x4a, 0x80, // 1760709248
+	0x61, 'w', 0x19, 0x01, 0x2c, // 300
+	0x61, 'g',
+};
+#define UNIX_TIME 1760709248
+
+void test_encode_byte_exact()
+{
+	int ldr = telemetry_add_gauge(&telemetry, "ldr");
+	int rssi = telemetry_add_gauge(&telemetry, "rssi");
+	telemetry_sample(&telemetry, ldr, 10);
+	telemetry_sample(&telemetry, ldr, 30);
+	telemetry_sample(&telemetry, ldr, 26);
+	telemetry_sample(&telemetry, rssi, -67);
+	telemetry_sample(&telemetry, rssi, -70);
+
+	static const uint8_t gauges[] = {
+		0xa2,
+		0x63, 'l', 'd', 'r', 0x84, 0x0a, 0x18, 0x1e, 0x16, 0x03, // [10, 30, 22, 3]
+		0x64, 'r', 's', 's', 'i', 0x84, 0x38, 0x45, 0x38, 0x42, 0x38, 0x43, 0x02, // [-70, -67, -68, 2]
+	};
+	uint8_t out[128];
+	size_t len = telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	TEST_ASSERT_EQUAL(sizeof(head) + sizeof(gauges), len);
+	TEST_ASSERT_EQUAL_MEMORY(head, out, sizeof(head));
+	TEST_ASSERT_EQUAL_MEMORY(gauges, out + sizeof(head), sizeof(gauges));
+}
+
+void test_integer_sizes()
+{
+	int g = telemetry_add_gauge(&telemetry, "x");
+	telemetry_sample(&telemetry, g, INT32_MIN);
+	telemetry_sample(&telemetry, g, 1000000);
+
+	static const uint8_t gauge[] = {
+		0xa1, 0x61, 'x', 0x84,
+		0x3a, 0x7f, 0xff, 0xff, 0xff, // -2^31
+		0x1a, 0x00, 0x0f, 0x42, 0x40, // 1000000
+		0x3a, 0x3f, 0xf8, 0x5e, 0xdf, // mean (-2147483648 + 1000000) / 2 = -1073241824
+		0x02,
+	};
+	uint8_t out[128];
+	size_t len = telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	TEST_ASSERT_EQUAL(sizeof(head) + sizeof(gauge), len);
+	TEST_ASSERT_EQUAL_MEMORY(gauge, out + sizeof(head), sizeof(gauge));
+}
+
+void test_boundaries_of_short_forms()
+{
+	int g = telemetry_add_gauge(&telemetry, "x");
+	telemetry_sample(&telemetry, g, 23);
+	telemetry_sample(&telemetry, g, 24);
+	uint8_t out[64];
+	telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	static const uint8_t values[] = { 0x84, 0x17, 0x18, 0x18, 0x17, 0x02 }; // 23, 24, 23 (mean), 2
+	TEST_ASSERT_EQUAL_MEMORY(values, out + sizeof(head) + 3, sizeof(values));
+
+	telemetry_reset(&telemetry);
+	telemetry_sample(&telemetry, g, -24);
+	telemetry_sample(&telemetry, g, -25);
+	telemetry_sample(&telemetry, g, 65536);
+	telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	static const uint8_t values2[] = { 0x84, 0x38, 0x18, 0x1a, 0x00, 0x01, 0x00, 0x00, 0x19, 0x55, 0x45, 0x03 }; // -25, 65536, 21829, 3
+	TEST_ASSERT_EQUAL_MEMORY(values2, out + sizeof(head) + 3, sizeof(values2));
+}
+
+void test_empty_gauges_are_skipped()
+{
+	telemetry_add_gauge(&telemetry, "a");
+	int b = telemetry_add_gauge(&telemetry, "b");
+	telemetry_add_gauge(&telemetry, "c");
+
+	uint8_t out[64];
+	size_t len = telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	TEST_ASSERT_EQUAL(sizeof(head) + 1, len);
+	TEST_ASSERT_EQUAL_HEX8(0xa0, out[sizeof(head)]); // empty map
+
+	telemetry_sample(&telemetry, b, 1);
+	len = telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	static const uint8_t gauges[] = { 0xa1, 0x61, 'b', 0x84, 0x01, 0x01, 0x01, 0x01 };
+	TEST_ASSERT_EQUAL(sizeof(head) + sizeof(gauges), len);
+	TEST_ASSERT_EQUAL_MEMORY(gauges, out + sizeof(head), sizeof(gauges));
+
+	// A new window starts empty, the gauges stay registered:
+	telemetry_reset(&telemetry);
+	TEST_ASSERT_EQUAL(sizeof(head) + 1, telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out)));
+	TEST_ASSERT_EQUAL(3, telemetry.gauge_count);
+}
+
+void test_overflow_returns_0()
+{
+	int g = telemetry_add_gauge(&telemetry, "heap_free");
+	telemetry_sample(&telemetry, g, 123456);
+
+	uint8_t out[64];
+	size_t len = telemetry_encode(&telemetry, UNIX_TIME, 300, out, sizeof(out));
+	TEST_ASSERT_TRUE(len > 0);
+
+	for (size_t size = 0; size < len; size++) {
+		memset(out, 0x55, sizeof(out));
+		TEST_ASSERT_EQUAL(0, telemetry_encode(&telemetry, UNIX_TIME, 300, out, size));
+		TEST_ASSERT_EQUAL_HEX8(0x55, out[size]); // Nothing written behind the buffer
+	}
+}
+
+void test_gauge_limit()
+{
+	for (int i = 0; i < TELEMETRY_MAX_GAUGES; i++)
+		TEST_ASSERT_EQUAL(i, telemetry_add_gauge(&telemetry, "g"));
+	TEST_ASSERT_EQUAL(-1, telemetry_add_gauge(&telemetry, "g"));
+
+	telemetry_sample(&telemetry, -1, 1); // ignored
+	telemetry_sample(&telemetry, TELEMETRY_MAX_GAUGES, 1);
+	for (int i = 0; i < TELEMETRY_MAX_GAUGES; i++)
+		TEST_ASSERT_EQUAL(0, telemetry.gauges[i].count);
+}
+
+// The gauges of main.cpp with a full window of typical values:
+static void fill_window()
+{
+	static const char *const names[] = { "ldr", "brightness", "heap_free", "rssi", "frame_us", "ntp_offset_us" };
+	memset(&telemetry, 0, sizeof(telemetry));
+	for (int i = 0; i < 6; i++)
+		telemetry_add_gauge(&telemetry, names[i]);
+	for (int s = 0; s < 300; s++) {
+		telemetry_sample(&telemetry, 0, 1800 + s % 200);
+		telemetry_sample(&telemetry, 1, 100 + s % 50);
+		telemetry_sample(&telemetry, 2, 210000 - s * 13);
+		telemetry_sample(&telemetry, 3, -60 - s % 15);
+		telemetry_sample(&telemetry, 4, 9000 + s * 7);
+	}
+	telemetry_sample(&telemetry, 5, -1234);
+	telemetry_sample(&telemetry, 5, 876);
+}
+
+// Same content as JSON, like it would be sent without CBOR:
+static size_t encode_json(char *out, size_t size)
+{
+	int len = snprintf(out, size, "{\"v\":%d,\"t\":%u,\"w\":%u,\"g\":{", TELEMETRY_VERSION, UNIX_TIME, 300);
+	for (int i = 0; i < telemetry.gauge_count; i++) {
+		const struct telemetry_gauge *g = &telemetry.gauges[i];
+		len += snprintf(out + len, size - len, "%s\"%s\":[%d,%d,%lld,%u]", i ? "," : "", g->name, (int)g->min, (int)g->max, (long long)(g->sum / g->count),
+		                (unsigned)g->count);
+	}
+	len += snprintf(out + len, size - len, "}}");
+	return len;
+}
+
+void test_benchmark()
+{
+	fill_window();
+
+	const int rounds = 100000;
+	uint8_t out[256];
+	char json[512];
+	size_t cbor_len = 0, json_len = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; i++)
+		cbor_len += telemetry_encode(&telemetry, UNIX_TIME + i, 300, out, sizeof(out));
+	auto middle = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; i++)
+		json_len += encode_json(json, sizeof(json));
+	auto end = std::chrono::steady_clock::now();
+
+	double cbor_ns = std::chrono::duration<double, std::nano>(middle - start).count() / rounds;
+	double json_ns = std::chrono::duration<double, std::nano>(end - middle).count() / rounds;
+
+	TEST_ASSERT_TRUE(cbor_len / rounds < 200); // Fits the 256 byte buffer of loop_telemetry()
+
+	char buf[160];
+	snprintf(buf, sizeof(buf), "6 gauges: CBOR %u bytes in %.0f ns, JSON %u bytes in %.0f ns", (unsigned)(cbor_len / rounds), cbor_ns, (unsigned)(json_len / rounds), json_ns);
+	TEST_MESSAGE(buf);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_encode_byte_exact);
+	RUN_TEST(test_integer_sizes);
+	RUN_TEST(test_boundaries_of_short_forms);
+	RUN_TEST(test_empty_gauges_are_skipped);
+	RUN_TEST(test_overflow_returns_0);
+	RUN_TEST(test_gauge_limit);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,243 @@
+// Multi panel canvas against a fake SPI bus with one chip select per panel.
+
+#include <unity.h>
+
+#include <string.h>
+
+#include "vfd_canvas.h"
+
+#define PANELS 3
+#define CANVAS_COLS (PANELS * VFD_PANEL_TILE_COLS)
+
+// What went over the bus, per chip select:
+struct fake_panel {
+	uint8_t tiles[VFD_PANEL_TILE_ROWS][VFD_PANEL_TILE_COLS][8];
+	int transfers;
+	int bytes;
+};
+
+struct transfer {
+	int panel;
+	uint8_t x, y, cnt;
+};
+
+struct fake_bus {
+	bool horizontal;
+	struct fake_panel panels[PANELS];
+	struct transfer log[VFD_PANEL_TILE_ROWS * CANVAS_COLS];
+	int log_count;
+};
+
+static struct vfd_canvas canvas;
+static struct fake_bus bus;
+
+// Like u8x8_DrawTile() on a GP1287: CS low, command + x/y/height, the tiles, CS high.
+static void bus_send(void *context, int panel, uint8_t x, uint8_t y, uint8_t cnt, uint8_t *tiles)
+{
+	struct fake_bus *b = (struct fake_bus *)context;
+	TEST_ASSERT_TRUE(panel >= 0 && panel < PANELS);
+	TEST_ASSERT_TRUE(x + cnt <= VFD_PANEL_TILE_COLS);
+
+	struct fake_panel *p = &b->panels[panel];
+	for (int i = 0; i < cnt; i++)
+		for (int row = 0; row < 8; row++)
+			p->tiles[y][x + i][row] = b->horizontal ? tiles[row * cnt + i] : tiles[i * 8 + row];
+	p->transfers++;
+	p->bytes += 4 + cnt * 8;
+
+	struct transfer t = { panel, x, y, cnt };
+	b->log[b->log_count++] = t;
+}
+
+static int flush()
+{
+	bus.log_count = 0;
+	return vfd_canvas_flush(&canvas, bus_send, &bus);
+}
+
+// A tile row as u8g2 delivers it: the whole canvas width in one DRAW_TILE.
+static uint8_t page[CANVAS_COLS * 8];
+
+static void page_set_tile(int col, uint8_t value)
+{
+	for (int row = 0; row < 8; row++) {
+		if (canvas.horizontal)
+			page[row * CANVAS_COLS + col] = value + row;
+		else
+			page[col * 8 + row] = value + row;
+	}
+}
+
+static void draw_page(int y)
+{
+	vfd_canvas_draw_tiles(&canvas, 0, y, CANVAS_COLS, page);
+}
+
+void setUp()
+{
+	memset(&bus, 0, sizeof(bus));
+	memset(page, 0, sizeof(page));
+	TEST_ASSERT_TRUE(vfd_canvas_init(&canvas, PANELS, false));
+}
+
+void tearDown()
+{
+}
+
+void test_init_checks_panel_count()
+{
+	TEST_ASSERT_FALSE(vfd_canvas_init(&canvas, 0, false));
+	TEST_ASSERT_FALSE(vfd_canvas_init(&canvas, VFD_MAX_PANELS + 1, false));
+	TEST_ASSERT_EQUAL(0, canvas.panels);
+
+	vfd_canvas_draw_tiles(&canvas, 0, 0, 1, (const uint8_t *)"\x01\x02\x03\x04\x05\x06\x07\x08");
+	TEST_ASSERT_EQUAL(0, flush());
+
+	TEST_ASSERT_TRUE(vfd_canvas_init(&canvas, VFD_MAX_PANELS, true));
+	TEST_ASSERT_EQUAL(VFD_MAX_PANELS, canvas.panels);
+}
+
+void test_slices_across_the_panel_boundary()
+{
+	// Tiles 30..33: the last 2 of panel 0 and the first 2 of panel 1
+	for (int col = 30; col < 34; col++)
+		page_set_tile(col, 0x10 * col);
+	draw_page(3);
+
+	TEST_ASSERT_EQUAL(4, flush());
+	TEST_ASSERT_EQUAL(2, bus.log_count);
+	TEST_ASSERT_EQUAL(0, bus.log[0].panel);
+	TEST_ASSERT_EQUAL(30, bus.log[0].x);
+	TEST_ASSERT_EQUAL(3, bus.log[0].y);
+	TEST_ASSERT_EQUAL(2, bus.log[0].cnt);
+	TEST_ASSERT_EQUAL(1, bus.log[1].panel);
+	TEST_ASSERT_EQUAL(0, bus.log[1].x);
+	TEST_ASSERT_EQUAL(2, bus.log[1].cnt);
+
+	TEST_ASSERT_EQUAL_HEX8((uint8_t)(0x10 * 31 + 7), bus.panels[0].tiles[3][31][7]);
+	TEST_ASSERT_EQUAL_HEX8((uint8_t)(0x10 * 32), bus.panels[1].tiles[3][0][0]);
+	TEST_ASSERT_EQUAL_HEX8((uint8_t)(0x10 * 33 + 3), bus.panels[1].tiles[3][1][3]);
+	TEST_ASSERT_EQUAL(0, bus.panels[2].transfers); // Not selected at all
+}
+
+static void check_layout(bool horizontal)
+{
+	TEST_ASSERT_TRUE(vfd_canvas_init(&canvas, PANELS, horizontal));
+	bus.horizontal = horizontal;
+
+	for (int col = 0; col < CANVAS_COLS; col++)
+		page_set_tile(col, col * 3 + 1);
+	for (int y = 0; y < VFD_PANEL_TILE_ROWS; y++)
+		draw_page(y);
+	TEST_ASSERT_EQUAL(PANELS * VFD_PANEL_TILE_ROWS * VFD_PANEL_TILE_COLS, flush());
+
+	// Every panel shows its slice, tile by tile:
+	for (int panel = 0; panel < PANELS; panel++) {
+		TEST_ASSERT_EQUAL(VFD_PANEL_TILE_ROWS, bus.panels[panel].transfers); // A run per tile row
+		for (int y = 0; y < VFD_PANEL_TILE_ROWS; y++)
+			for (int col = 0; col < VFD_PANEL_TILE_COLS; col++)
+				for (int row = 0; row < 8; row++)
+					TEST_ASSERT_EQUAL_HEX8((uint8_t)((panel * VFD_PANEL_TILE_COLS + col) * 3 + 1 + row), bus.panels[panel].tiles[y][col][row]);
+	}
+}
+
+void test_vertical_layout()
+{
+	check_layout(false);
+}
+
+void test_horizontal_layout()
+{
+	check_layout(true);
+}
+
+void test_changed_tiles_are_merged_into_runs()
+{
+	for (int col = 0; col < CANVAS_COLS; col++)
+		page_set_tile(col, 1);
+	draw_page(0);
+	flush();
+
+	// Change tiles 1, 2, 3 and 7 of panel 0 and the last tile of panel 2:
+	page_set_tile(1, 2);
+	page_set_tile(2, 2);
+	page_set_tile(3, 2);
+	page_set_tile(7, 2);
+	page_set_tile(CANVAS_COLS - 1, 2);
+	draw_page(0);
+
+	TEST_ASSERT_EQUAL(5, flush());
+	TEST_ASSERT_EQUAL(3, bus.log_count);
+	TEST_ASSERT_EQUAL(1, bus.log[0].x);
+	TEST_ASSERT_EQUAL(3, bus.log[0].cnt);
+	TEST_ASSERT_EQUAL(7, bus.log[1].x);
+	TEST_ASSERT_EQUAL(1, bus.log[1].cnt);
+	TEST_ASSERT_EQUAL(2, bus.log[2].panel);
+	TEST_ASSERT_EQUAL(VFD_PANEL_TILE_COLS - 1, bus.log[2].x);
+}
+
+void test_unchanged_frame_sends_nothing()
+{
+	for (int col = 0; col < CANVAS_COLS; col++)
+		page_set_tile(col, col);
+	for (int y = 0; y < VFD_PANEL_TILE_ROWS; y++)
+		draw_page(y);
+	TEST_ASSERT_TRUE(flush() > 0);
+
+	int bytes = bus.panels[0].bytes + bus.panels[1].bytes + bus.panels[2].bytes;
+	for (int y = 0; y < VFD_PANEL_TILE_ROWS; y++)
+		draw_page(y);
+	TEST_ASSERT_EQUAL(0, flush());
+	TEST_ASSERT_EQUAL(bytes, bus.panels[0].bytes + bus.panels[1].bytes + bus.panels[2].bytes);
+}
+
+void test_invalidate_resends_everything()
+{
+	vfd_canvas_invalidate(&canvas);
+	TEST_ASSERT_EQUAL(PANELS * VFD_PANEL_TILE_ROWS * VFD_PANEL_TILE_COLS, flush());
+	for (int panel = 0; panel < PANELS; panel++)
+		TEST_ASSERT_EQUAL(VFD_PANEL_TILE_ROWS * (4 + VFD_PANEL_TILE_COLS * 8), bus.panels[panel].bytes);
+}
+
+// A clock second on the middle panel only, the others stay quiet:
+void test_bytes_per_panel()
+{
+	for (int col = 0; col < CANVAS_COLS; col++)
+		page_set_tile(col, 0x40);
+	for (int y = 0; y < VFD_PANEL_TILE_ROWS; y++)
+		draw_page(y);
+	flush();
+	memset(bus.panels, 0, sizeof(bus.panels));
+
+	page_set_tile(VFD_PANEL_TILE_COLS + 10, 0x41);
+	page_set_tile(VFD_PANEL_TILE_COLS + 11, 0x41);
+	draw_page(2);
+	draw_page(3);
+	flush();
+
+	TEST_ASSERT_EQUAL(0, bus.panels[0].bytes);
+	TEST_ASSERT_EQUAL(2 * (4 + 2 * 8), bus.panels[1].bytes);
+	TEST_ASSERT_EQUAL(0, bus.panels[2].bytes);
+}
+
+void test_rows_outside_the_panel_are_ignored()
+{
+	page_set_tile(0, 1);
+	vfd_canvas_draw_tiles(&canvas, 0, VFD_PANEL_TILE_ROWS, CANVAS_COLS, page);
+	TEST_ASSERT_EQUAL(0, flush());
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init_checks_panel_count);
+	RUN_TEST(test_slices_across_the_panel_boundary);
+	RUN_TEST(test_vertical_layout);
+	RUN_TEST(test_horizontal_layout);
+	RUN_TEST(test_changed_tiles_are_merged_into_runs);
+	RUN_TEST(test_unchanged_frame_sends_nothing);
+	RUN_TEST(test_invalidate_resends_everything);
+	RUN_TEST(test_bytes_per_panel);
+	RUN_TEST(test_rows_outside_the_panel_are_ignored);
+	return UNITY_END();
+}
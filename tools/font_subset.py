@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+#
+# Build step: subset the u8g2 fonts used by main.cpp to the glyphs we really
+# draw and emit them as directly indexed, pre-decoded bitmaps.
+#
+# u8g2 looks up each glyph by walking over all glyphs of the font and decodes
+# the RLE bitmap while drawing. The _tf fonts carry ~190 glyphs, we need ~60.
+#
+# The texts are taken from the draw_text(&<subset>, x, y, "format", ...) calls
+# in main.cpp. printf conversions are expanded to the characters they can
+# produce, a %s argument must be an element of a const char *name[] array.
+#
+# Used as PlatformIO pre script (see platformio.ini) or standalone:
+#   tools/font_subset.py <u8g2_fonts.c> <main.cpp> <font_subset_data.h>
+
+import os
+import re
+import sys
+
+# u8g2 font name -> C name of the subset
+FONTS = {
+    "u8g2_font_5x8_tf": "font_5x8_subset",
+    "u8g2_font_6x10_tf": "font_6x10_subset",
+    "u8g2_font_5x7_tf": "font_5x7_subset",
+}
+
+DIGITS = "0123456789"
+
+# Characters a printf conversion can produce (without the padding):
+CONVERSIONS = {
+    "d": DIGITS + "-", "i": DIGITS + "-", "u": DIGITS,
+    "x": DIGITS + "abcdef", "X": DIGITS + "ABCDEF",
+    "f": DIGITS + "-.",
+}
+
+
+def decode_c_string(s):
+    out = bytearray()
+    i = 0
+    while i < len(s):
+        c = s[i]
+        if c != "\\":
+            out += c.encode("latin-1")
+            i += 1
+            continue
+        i += 1
+        c = s[i]
+        if c in "01234567":
+            j = i
+            while j < len(s) and j < i + 3 and s[j] in "01234567":
+                j += 1
+            out.append(int(s[i:j], 8))
+            i = j
+        elif c == "x":
+            j = i + 1
+            while j < len(s) and s[j] in "0123456789abcdefABCDEF":
+                j += 1
+            out.append(int(s[i + 1:j], 16) & 0xff)
+            i = j
+        else:
+            out += {"n": b"\n", "r": b"\r", "t": b"\t"}.get(c, c.encode("latin-1"))
+            i += 1
+    return bytes(out)
+
+
+def string_literals(text, pos):
+    """Return the C string literals starting at pos up to the first ';' outside of them."""
+    literals = []
+    while True:
+        if pos >= len(text):
+            raise ValueError("missing ';'")
+        c = text[pos]
+        if c == ";":
+            return literals
+        if c == '"':
+            end = pos + 1
+            while text[end] != '"':
+                end += 2 if text[end] == "\\" else 1
+            literals.append(text[pos + 1:end])
+            pos = end
+        pos += 1
+
+
+def read_font(fonts_c, name):
+    m = re.search(r"const\s+uint8_t\s+%s\s*\[\s*\d+\s*\][^=]*=" % name, fonts_c)
+    if not m:
+        raise ValueError("font %s not found" % name)
+    return b"".join(decode_c_string(s) for s in string_literals(fonts_c, m.end()))
+
+
+class BitReader:
+    def __init__(self, data, pos):
+        self.data = data
+        self.pos = pos
+        self.bit = 0
+
+    def unsigned(self, cnt):
+        val = self.data[self.pos] >> self.bit
+        bit = self.bit + cnt
+        if bit >= 8:
+            self.pos += 1
+            val |= self.data[self.pos] << (8 - self.bit)
+            bit -= 8
+        self.bit = bit
+        return val & ((1 << cnt) - 1)
+
+    def signed(self, cnt):
+        return self.unsigned(cnt) - (1 << (cnt - 1))
+
+
+def decode_glyph(font, pos):
+    """Decode the glyph at pos (pointing behind encoding and jump byte)."""
+    bits_per_0, bits_per_1 = font[2], font[3]
+    r = BitReader(font, pos)
+    w = r.unsigned(font[4])
+    h = r.unsigned(font[5])
+    x = r.signed(font[6])
+    y = r.signed(font[7])
+    dx = r.signed(font[8])
+
+    pixels = [[0] * w for _ in range(h)]
+    if w > 0:
+        lx = ly = 0
+
+        def run(cnt, color):
+            nonlocal lx, ly
+            while True:
+                rem = w - lx
+                current = min(cnt, rem)
+                if color:
+                    for i in range(current):
+                        pixels[ly][lx + i] = 1
+                if cnt < rem:
+                    break
+                cnt -= rem
+                lx = 0
+                ly += 1
+            lx += cnt
+
+        while True:
+            a = r.unsigned(bits_per_0)
+            b = r.unsigned(bits_per_1)
+            while True:
+                run(a, 0)
+                run(b, 1)
+                if r.unsigned(1) == 0:
+                    break
+            if ly >= h:
+                break
+
+    return w, h, x, y, dx, pixels
+
+
+def read_glyphs(font, wanted):
+    glyphs = {}
+    pos = 23 # size of the font header
+    while font[pos + 1] != 0:
+        if font[pos] in wanted:
+            glyphs[font[pos]] = decode_glyph(font, pos + 2)
+        pos += font[pos + 1]
+    return glyphs
+
+
+def call_arguments(text, pos):
+    """Split the arguments of the call whose '(' is at pos."""
+    args = []
+    depth = 0
+    start = pos + 1
+    i = pos
+    while True:
+        c = text[i]
+        if c == '"' or c == "'":
+            i += 1
+            while text[i] != c:
+                i += 2 if text[i] == "\\" else 1
+        elif c in "([{":
+            depth += 1
+        elif c in ")]}":
+            depth -= 1
+            if depth == 0:
+                args.append(text[start:i].strip())
+                return args
+        elif c == "," and depth == 1:
+            args.append(text[start:i].strip())
+            start = i + 1
+        i += 1
+
+
+def array_strings(main_cpp, name):
+    """All strings of the arrays "name", of all languages."""
+    arrays = re.findall(r"\b%s\[\]\s*=\s*\{(.*?)\};" % name, main_cpp, re.S)
+    if not arrays:
+        return None
+    return [s for body in arrays for s in re.findall(r'"((?:[^"\\]|\\.)*)"', body)]
+
+
+def format_texts(main_cpp, call, fmt, args):
+    """Expand a printf format to the texts/characters it can produce."""
+    texts = []
+    pieces = re.split(r"(%[-+ 0#]*\d*(?:\.\d+)?(?:hh|h|ll|l|z)?[a-zA-Z%])", fmt)
+    for n, piece in enumerate(pieces):
+        if n % 2 == 0:
+            texts.append(piece)
+            continue
+        conversion = piece[-1]
+        if conversion == "%":
+            texts.append("%")
+            continue
+        if not args:
+            raise ValueError("%s: more conversions than arguments" % call)
+        arg = args.pop(0)
+        if conversion == "s":
+            m = re.match(r"(\w+)\s*\[", arg)
+            strings = array_strings(main_cpp, m.group(1)) if m else None
+            if strings is None:
+                raise ValueError("%s: %%s argument '%s' is not an element of a string array" % (call, arg))
+            texts.extend(strings)
+        elif conversion in CONVERSIONS:
+            texts.append(CONVERSIONS[conversion])
+            flags, width = re.match(r"%([-+ 0#]*)(\d*)", piece).groups()
+            if " " in flags or (width and ("0" not in flags or "-" in flags)):
+                texts.append(" ") # padding
+            if "+" in flags:
+                texts.append("+")
+        else:
+            raise ValueError("%s: conversion %s not supported" % (call, piece))
+    return texts
+
+
+def collect_texts(main_cpp):
+    """Subset C name -> texts of all draw_text() calls."""
+    texts = {}
+    for m in re.finditer(r"\bdraw_text\s*\(", main_cpp):
+        args = call_arguments(main_cpp, m.end() - 1)
+        if not args[0].startswith("&"):
+            continue # the declaration
+        call = "draw_text(%s)" % ", ".join(args)
+        c_name = args[0][1:]
+        if c_name not in FONTS.values():
+            raise ValueError("%s: unknown font" % call)
+        if not re.match(r'^"(?:[^"\\]|\\.)*"$', args[3]):
+            raise ValueError("%s: format must be a string literal" % call)
+        # decode_c_string() works on bytes as chars, main.cpp is UTF-8:
+        fmt = decode_c_string(args[3][1:-1].encode("utf-8").decode("latin-1")).decode("utf-8")
+        texts.setdefault(c_name, []).extend(format_texts(main_cpp, call, fmt, args[4:]))
+    return texts
+
+
+def wanted_chars(c_name, texts):
+    chars = set("".join(texts))
+    # Glyph encodings of the _tf fonts are Latin-1:
+    outside = [c for c in chars if ord(c) > 255]
+    if outside:
+        raise ValueError("%s: %r not in Latin-1" % (c_name, outside))
+    return sorted(ord(c) for c in chars)
+
+
+def c_bytes(out, data):
+    for i in range(0, len(data), 16):
+        out.append("\t" + ", ".join("0x%02x" % v for v in data[i:i + 16]) + ",")
+
+
+def c_string(text):
+    return '"%s"' % "".join(chr(b) if 0x20 <= b < 0x7f and chr(b) not in '"\\?' else "\\%03o" % b for b in text.encode("utf-8"))
+
+
+def emit_font(out, c_name, font, glyphs):
+    index = [0xff] * 256
+    bitmaps = []
+    entries = []
+    for n, (encoding, (w, h, x, y, dx, pixels)) in enumerate(sorted(glyphs.items())):
+        index[encoding] = n
+        entries.append("\t{ %d, %d, %d, %d, %d, %d }, // '%s'" % (w, h, x, y, dx, len(bitmaps), chr(encoding)))
+        for row in pixels: # XBM layout, lsb is the leftmost pixel
+            for bx in range(0, w, 8):
+                bitmaps.append(sum(1 << i for i, p in enumerate(row[bx:bx + 8]) if p))
+
+    out.append("static const uint8_t %s_index[256] = {" % c_name)
+    c_bytes(out, index)
+    out.append("};\n")
+    out.append("static const struct subset_glyph %s_glyphs[] = {" % c_name)
+    out.extend(entries)
+    out.append("};\n")
+    out.append("static const uint8_t %s_bitmaps[] = {" % c_name)
+    c_bytes(out, bitmaps)
+    out.append("};\n")
+    # Font header: 9 = max glyph width, 10 = max glyph height
+    out.append("const struct subset_font %s = { %s_index, %s_glyphs, %s_bitmaps, %d, %d };\n" % (c_name, c_name, c_name, c_name, font[9], font[10]))
+
+
+def emit_reference(out, c_name, font, texts):
+    out.append("static const uint8_t %s_u8g2[] = {" % c_name)
+    c_bytes(out, font)
+    out.append("};\n")
+    out.append("static const char *const %s_texts[] = {" % c_name)
+    out.extend("\t%s," % c_string(t) for t in texts)
+    out.append("\tNULL,")
+    out.append("};\n")
+
+
+def generate(fonts_c_path, main_cpp_path, out_path):
+    with open(fonts_c_path, encoding="latin-1") as f:
+        fonts_c = f.read()
+    with open(main_cpp_path, encoding="utf-8") as f:
+        main_cpp = f.read()
+
+    all_texts = collect_texts(main_cpp)
+    out = ["// Generated by tools/font_subset.py, do not edit.\n"]
+    reference = ["#ifdef FONT_SUBSET_REFERENCE", "// Complete u8g2 fonts and the texts of the subsets, for the host tests.\n"]
+    references = []
+    for font_name, c_name in FONTS.items():
+        if c_name not in all_texts:
+            raise ValueError("%s is not used by any draw_text() call" % c_name)
+        texts = list(dict.fromkeys(t for t in all_texts[c_name] if t))
+        font = read_font(fonts_c, font_name)
+        wanted = wanted_chars(c_name, texts)
+        glyphs = read_glyphs(font, set(wanted))
+        missing = [chr(c) for c in wanted if c not in glyphs]
+        if missing:
+            raise ValueError("%s has no glyph for %r" % (font_name, missing))
+        out.append("// %s: %d of %d glyphs, %d bytes font data" % (font_name, len(glyphs), font[0], len(font)))
+        emit_font(out, c_name, font, glyphs)
+        emit_reference(reference, c_name, font, texts)
+        references.append('\t{ "%s", %s_u8g2, &%s, %s_texts },' % (font_name, c_name, c_name, c_name))
+
+    reference.append("const struct subset_reference font_subset_references[] = {")
+    reference.extend(references)
+    reference.append("};\n")
+    reference.append("const int font_subset_reference_count = %d;" % len(references))
+    reference.append("#endif\n")
+
+    with open(out_path, "w") as f:
+        f.write("\n".join(out + reference))
+
+
+def main(env):
+    project_dir = env.subst("$PROJECT_DIR")
+    fonts_c = env.subst("$PROJECT_LIBDEPS_DIR/$PIOENV/U8g2/src/clib/u8g2_fonts.c")
+    main_cpp = os.path.join(project_dir, "src", "main.cpp")
+    out = os.path.join(project_dir, "include", "font_subset_data.h")
+    script = os.path.join(project_dir, "tools", "font_subset.py")
+
+    if not os.path.exists(fonts_c):
+        sys.stderr.write("font_subset: %s not found\n" % fonts_c)
+        env.Exit(1)
+
+    if os.path.exists(out) and os.path.getmtime(out) >= max(os.path.getmtime(p) for p in (fonts_c, main_cpp, script)):
+        return
+    print("font_subset: generating %s" % out)
+    generate(fonts_c, main_cpp, out)
+
+
+if "Import" in globals(): # running inside PlatformIO/SCons
+    Import("env") # noqa: F821
+    main(env) # noqa: F821
+elif __name__ == "__main__":
+    if len(sys.argv) != 4:
+        sys.exit("usage: %s <u8g2_fonts.c> <main.cpp> <font_subset_data.h>" % sys.argv[0])
+    generate(*sys.argv[1:])
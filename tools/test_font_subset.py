@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+#
+# Checks of the parsers in tools/font_subset.py: python3 tools/test_font_subset.py
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import font_subset # noqa: E402
+
+
+class ReadFont(unittest.TestCase):
+    def test_semicolon_inside_string(self):
+        c = 'const uint8_t u8g2_font_x_tf[9] U8G2_FONT_SECTION("u8g2_font_x_tf") = \n  "ab;cd" "efgh\\0";\nint other = 1;'
+        self.assertEqual(font_subset.read_font(c, "u8g2_font_x_tf"), b"ab;cdefgh\0")
+
+    def test_escapes(self):
+        c = 'const uint8_t f[4] = "\\340\\"\\\\\\x41";'
+        self.assertEqual(font_subset.read_font(c, "f"), b"\xe0\"\\A")
+
+    def test_missing_font(self):
+        self.assertRaises(ValueError, font_subset.read_font, "", "f")
+
+
+MAIN_CPP = '''
+const char *days[] = { "Mo", "Di" };
+const char *months[] = { "März" };
+int draw_text(const struct subset_font *font, int x, int y, const char *format, ...);
+void draw()
+{
+	draw_text(&font_5x8_subset, x, f(y, 2), "%s", days[t.tm_wday]);
+	draw_text(&font_6x10_subset, 1, 2, "%s, %d", months[m], year);
+	draw_text(&font_6x10_subset, 1, 2, "%06u / %2.1f%%;", a, b);
+}
+'''
+
+
+class CollectTexts(unittest.TestCase):
+    def test_draw_text_calls(self):
+        texts = font_subset.collect_texts(MAIN_CPP)
+        self.assertEqual(texts["font_5x8_subset"], ["", "Mo", "Di", ""])
+        chars = font_subset.wanted_chars("font_6x10_subset", texts["font_6x10_subset"])
+        self.assertEqual("".join(map(chr, chars)), " %,-./0123456789;Mrzä")
+
+    def test_unknown_array(self):
+        self.assertRaises(ValueError, font_subset.collect_texts, 'draw_text(&font_5x8_subset, 0, 0, "%s", name);')
+
+    def test_unknown_font(self):
+        self.assertRaises(ValueError, font_subset.collect_texts, 'draw_text(&font_9x9_subset, 0, 0, "x");')
+
+    def test_format_not_literal(self):
+        self.assertRaises(ValueError, font_subset.collect_texts, 'draw_text(&font_5x8_subset, 0, 0, text);')
+
+    def test_outside_latin1(self):
+        self.assertRaises(ValueError, font_subset.wanted_chars, "font_5x8_subset", ["€"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+#
+# Checks of tools/vfd_trace.py with synthetic traces: python3 tools/test_vfd_trace.py
+
+import os
+import struct
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import vfd_trace # noqa: E402
+from vfd_trace import START, END, FRAME, DC, DATA # noqa: E402
+
+
+class Recorder:
+    """Writes records like src/spi_trace.cpp."""
+
+    def __init__(self):
+        self.records = bytearray()
+        self.last = None
+
+    def event(self, kind, t, arg=0):
+        delta = 0 if self.last is None else t - self.last
+        self.last = t
+        self.records.append((kind << 5) | arg)
+        while True:
+            b = delta & 0x7f
+            delta >>= 7
+            self.records.append(b | (0x80 if delta else 0))
+            if not delta:
+                break
+
+    def dc(self, level):
+        self.records.append((DC << 5) | level)
+
+    def data(self, payload):
+        if len(payload) < 32:
+            self.records.append((DATA << 5) | len(payload))
+        else:
+            self.records += bytes([DATA << 5, len(payload)])
+        self.records += payload
+
+    def transaction(self, t, cmd, args=b"", data=b"", panel=0):
+        self.event(START, t, panel)
+        self.dc(0)
+        self.data(cmd)
+        if args or data:
+            self.dc(1)
+            self.data(args + data)
+        self.event(END, t + 10)
+
+    def dump(self, spi_hz=4000000, dropped=0):
+        return b"VFDT" + bytes([1, 0, 0, 0]) + struct.pack("<III", len(self.records), dropped, spi_hz) + bytes(self.records)
+
+
+def tile_write(rec, t, x, y, columns, panel=0):
+    rec.transaction(t, b"\xf0", bytes([x, y, 7]), bytes(columns), panel)
+
+
+def two_frames():
+    rec = Recorder()
+    rec.transaction(0, b"\xaa") # before the first frame, skipped
+    rec.event(FRAME, 100)
+    rec.transaction(110, b"\x80\x01")
+    tile_write(rec, 130, 8, 8, [0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80]) # diagonal
+    rec.transaction(150, b"\x80\x01")
+    rec.event(FRAME, 1000)
+    tile_write(rec, 1010, 248, 48, [0xff] * 8) # bottom right tile, partly below row 50
+    return rec
+
+
+class Parse(unittest.TestCase):
+    def test_events_and_frames(self):
+        spi_hz, dropped, events = vfd_trace.parse(two_frames().dump())
+        self.assertEqual(spi_hz, 4000000)
+        self.assertEqual(dropped, 0)
+        self.assertEqual(events[0], (START, 0, 0))
+        self.assertEqual(events[1], (DC, 0, 0))
+        self.assertEqual([e[1] for e in events if e[0] == FRAME], [100, 1000])
+
+        frames = vfd_trace.split_frames(events)
+        self.assertEqual(len(frames), 2)
+        self.assertEqual(len(frames[0].transactions), 3)
+        self.assertEqual(frames[0].transactions[1]["parts"], [(0, b"\xf0"), (1, bytes([8, 8, 7, 1, 2, 4, 8, 16, 32, 64, 128]))])
+        self.assertEqual(frames[0].end_us, 160)
+
+    def test_stats(self):
+        frames = vfd_trace.split_frames(vfd_trace.parse(two_frames().dump())[2])
+        cmd, data, repeated = vfd_trace.frame_stats(frames[0])
+        self.assertEqual((cmd, data, repeated), (5, 11, 1)) # 80 01 sent twice
+        # 16 bytes at 1 MHz = 128 us, plus 3 transactions at 2 us
+        self.assertAlmostEqual(vfd_trace.bus_time_us(frames[0], 1e6, 2.0), 134.0)
+
+    def test_long_data_and_large_delta(self):
+        rec = Recorder()
+        rec.event(FRAME, 0)
+        rec.transaction(300000, b"\xf0", bytes([0, 0, 7]), bytes(range(100)))
+        events = vfd_trace.parse(rec.dump())[2]
+        self.assertEqual(events[1], (START, 300000, 0))
+        self.assertEqual(len(events[-2][2]), 103)
+
+    def test_truncated(self):
+        self.assertRaises(SystemExit, vfd_trace.parse, two_frames().dump()[:-1])
+
+    def test_serial_log(self):
+        dump = two_frames().dump()
+        with tempfile.NamedTemporaryFile("w", suffix=".log", delete=False) as f:
+            f.write("boot messages\n")
+            for i in range(0, len(dump), 32):
+                f.write("TRACE: %s\n" % dump[i:i + 32].hex())
+        try:
+            self.assertEqual(vfd_trace.load(f.name, True), dump)
+        finally:
+            os.unlink(f.name)
+
+
+class Pbm(unittest.TestCase):
+    def read(self, path):
+        with open(path) as f:
+            lines = f.read().split("\n")
+        self.assertEqual(lines[:2], ["P1", "256 50"])
+        return lines[2:52]
+
+    def test_frames(self):
+        frames = vfd_trace.split_frames(vfd_trace.parse(two_frames().dump())[2])
+        with tempfile.TemporaryDirectory() as d:
+            self.assertEqual(vfd_trace.write_pbm(frames, d, False, 0), [1, 1])
+
+            rows = self.read(os.path.join(d, "frame_0000.pbm"))
+            on = [(x, y) for y, row in enumerate(rows) for x, p in enumerate(row) if p == "1"]
+            self.assertEqual(on, [(8 + i, 8 + i) for i in range(8)])
+
+            # The display keeps its content, frame 1 adds the bottom right tile:
+            rows = self.read(os.path.join(d, "frame_0001.pbm"))
+            self.assertEqual(rows[8][8], "1")
+            self.assertEqual(rows[49][248:], "1" * 8)
+            self.assertEqual(rows[47][248:], "0" * 8)
+
+    def test_panels_side_by_side(self):
+        rec = Recorder()
+        rec.event(FRAME, 0)
+        tile_write(rec, 10, 0, 0, [0x01], panel=0)
+        tile_write(rec, 20, 0, 0, [0x01, 0x01], panel=1)
+        tile_write(rec, 30, 8, 0, [0x01], panel=1)
+        frames = vfd_trace.split_frames(vfd_trace.parse(rec.dump())[2])
+
+        stats = vfd_trace.panel_stats(frames[0])
+        self.assertEqual(dict(stats), {0: [1, 5], 1: [2, 11]})
+
+        with tempfile.TemporaryDirectory() as d:
+            vfd_trace.write_pbm(frames, d, False, 0)
+            with open(os.path.join(d, "frame_0000.pbm")) as f:
+                lines = f.read().split("\n")
+            self.assertEqual(lines[1], "512 50")
+            self.assertEqual([x for x, p in enumerate(lines[2]) if p == "1"], [0, 256, 257, 264])
+
+    def test_msb_top_and_offset(self):
+        rec = Recorder()
+        rec.event(FRAME, 0)
+        tile_write(rec, 10, 0, 8, [0x80])
+        frames = vfd_trace.split_frames(vfd_trace.parse(rec.dump())[2])
+        with tempfile.TemporaryDirectory() as d:
+            vfd_trace.write_pbm(frames, d, True, 4)
+            rows = self.read(os.path.join(d, "frame_0000.pbm"))
+            self.assertEqual(rows[4][0], "1") # RAM row 8 is display row 4
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,278 @@
+#!/usr/bin/env python3
+#
+# Analyze a display SPI trace recorded by the clock (see spi_trace.h).
+#
+# Get a trace via MQTT (payloads are the raw chunks of the dump):
+#   mosquitto_sub -h <broker> -t clock/matrix-vfd/trace/data -N > trace.bin
+#   mosquitto_pub -h <broker> -t clock/matrix-vfd/trace/cmd -m dump
+# or via serial ("dump serial", lines starting with "TRACE: ") and --serial.
+#
+# Reports per frame: bytes, command/data bytes, transactions, recorded bus
+# time, repeated command sequences and the bus time for other SPI clocks.
+# Several panels on one bus are told apart by the START records (panel = chip
+# select), bytes and transactions are also reported per panel.
+# With --pbm the GP1287 RAM writes are replayed and the display content after
+# each frame is written as PBM image, the panels side by side.
+
+import argparse
+import collections
+import os
+import struct
+import sys
+
+START, END, FRAME, DC, DATA = range(5)
+NAMES = ["START", "END", "FRAME", "DC", "DATA"]
+
+
+def load(path, serial):
+    if not serial:
+        with open(path, "rb") as f:
+            return f.read()
+    data = bytearray()
+    with open(path, errors="replace") as f:
+        for line in f:
+            idx = line.find("TRACE: ")
+            if idx >= 0:
+                data += bytes.fromhex(line[idx + 7:].strip())
+    return bytes(data)
+
+
+def parse(dump):
+    magic, version, length, dropped, spi_hz = struct.unpack_from("<4sB3xIII", dump)
+    if magic != b"VFDT" or version != 1:
+        sys.exit("not a VFD trace (version 1)")
+    records = dump[20:20 + length]
+    if len(records) < length:
+        sys.exit("trace truncated: %d of %d bytes" % (len(records), length))
+
+    events = [] # (type, time_us, value)
+    t = None
+    pos = 0
+    while pos < len(records):
+        first = records[pos]
+        kind, arg = first >> 5, first & 0x1f
+        pos += 1
+        if kind == DC:
+            events.append((DC, t, arg))
+        elif kind == DATA:
+            n = arg
+            if n == 0:
+                n = records[pos]
+                pos += 1
+            events.append((DATA, t, records[pos:pos + n]))
+            pos += n
+        elif kind in (START, END, FRAME):
+            panel = arg if kind == START else None
+            delta = shift = 0
+            while True:
+                b = records[pos]
+                pos += 1
+                delta |= (b & 0x7f) << shift
+                shift += 7
+                if not b & 0x80:
+                    break
+            # The first delta refers to a record dropped from the ring:
+            t = 0 if t is None else t + delta
+            events.append((kind, t, panel))
+        else:
+            sys.exit("bad record type %d at offset %d" % (kind, pos - 1))
+    return spi_hz, dropped, events
+
+
+class Frame:
+    def __init__(self, start_us):
+        self.start_us = start_us
+        self.end_us = start_us
+        self.transactions = []
+
+
+def split_frames(events):
+    """Transactions grouped by FRAME markers, data before the first marker is skipped."""
+    frames = []
+    frame = None
+    dc = 0
+    txn = None
+    for kind, t, value in events:
+        if kind == FRAME:
+            frame = Frame(t)
+            frames.append(frame)
+        elif frame is None:
+            continue
+        elif kind == START:
+            txn = {"start": t, "end": t, "panel": value, "parts": []}
+        elif kind == END and txn is not None:
+            txn["end"] = t
+            frame.transactions.append(txn)
+            frame.end_us = t
+            txn = None
+        elif kind == DC:
+            dc = value
+        elif kind == DATA and txn is not None:
+            parts = txn["parts"]
+            if parts and parts[-1][0] == dc:
+                parts[-1] = (dc, parts[-1][1] + value)
+            else:
+                parts.append((dc, bytes(value)))
+    return frames
+
+
+def frame_stats(frame):
+    cmd = data = 0
+    seen = collections.Counter()
+    repeated = 0
+    for txn in frame.transactions:
+        for dc, payload in txn["parts"]:
+            if dc == 0:
+                cmd += len(payload)
+                if seen[payload]:
+                    repeated += 1
+                seen[payload] += 1
+            else:
+                data += len(payload)
+    return cmd, data, repeated
+
+
+class Gp1287:
+    """Display RAM of the GP1287, written by the u8g2 driver via
+
+         C f0, x, y, rows - 1  (command byte, the arguments may be sent as data)
+         D column bytes: for each column (rows / 8) bytes of 8 vertical pixels
+
+    x/y are pixels, y a multiple of 8. Bit 0 is the top pixel unless msb_top."""
+
+    WIDTH = 256
+    HEIGHT = 50
+    RAM_HEIGHT = 64
+
+    def __init__(self, msb_top=False, y_offset=0):
+        self.msb_top = msb_top
+        self.y_offset = y_offset
+        self.ram = [[0] * self.WIDTH for _ in range(self.RAM_HEIGHT)]
+        self.writes = 0
+
+    def transaction(self, parts):
+        stream = [(dc, b) for dc, payload in parts for b in payload]
+        i = 0
+        while i < len(stream):
+            dc, b = stream[i]
+            i += 1
+            if dc != 0 or b != 0xf0 or i + 3 > len(stream):
+                continue # other commands don't change the RAM
+            x, y, rows = (v for _, v in stream[i:i + 3])
+            i += 3
+            data = []
+            while i < len(stream) and stream[i][0] == 1:
+                data.append(stream[i][1])
+                i += 1
+            self.write(x, y, rows + 1, data)
+
+    def write(self, x, y, rows, data):
+        self.writes += 1
+        per_column = (rows + 7) // 8
+        for n, value in enumerate(data):
+            col = x + n // per_column
+            top = y + (n % per_column) * 8
+            for bit in range(8):
+                row = top + (7 - bit if self.msb_top else bit)
+                if col < self.WIDTH and row < self.RAM_HEIGHT:
+                    self.ram[row][col] = (value >> bit) & 1
+
+    def rows(self):
+        return ["".join(str(p) for p in row) for row in self.ram[self.y_offset:self.y_offset + self.HEIGHT]]
+
+
+def write_pbm(frames, directory, msb_top, y_offset):
+    """Replay all frames, write <directory>/frame_<n>.pbm after each. Returns the RAM writes per frame."""
+    os.makedirs(directory, exist_ok=True)
+    panels = max([txn["panel"] for frame in frames for txn in frame.transactions] + [0]) + 1
+    displays = [Gp1287(msb_top, y_offset) for _ in range(panels)]
+    writes = []
+    for n, frame in enumerate(frames):
+        before = sum(d.writes for d in displays)
+        for txn in frame.transactions:
+            displays[txn["panel"]].transaction(txn["parts"])
+        writes.append(sum(d.writes for d in displays) - before)
+
+        rows = ["".join(row) for row in zip(*(d.rows() for d in displays))]
+        with open(os.path.join(directory, "frame_%04d.pbm" % n), "w") as f:
+            f.write("P1\n%d %d\n%s\n" % (len(rows[0]), len(rows), "\n".join(rows)))
+    return writes
+
+
+def panel_stats(frame):
+    """panel -> [transactions, bytes]"""
+    stats = collections.defaultdict(lambda: [0, 0])
+    for txn in frame.transactions:
+        stats[txn["panel"]][0] += 1
+        stats[txn["panel"]][1] += sum(len(p) for _, p in txn["parts"])
+    return stats
+
+
+def bus_time_us(frame, hz, txn_overhead_us):
+    nbytes = sum(len(p) for txn in frame.transactions for _, p in txn["parts"])
+    return nbytes * 8 * 1e6 / hz + len(frame.transactions) * txn_overhead_us
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Analyze a display SPI trace of the VFD clock.")
+    ap.add_argument("trace")
+    ap.add_argument("--serial", action="store_true", help="input is a serial log with TRACE: lines")
+    ap.add_argument("--spi-hz", default="", help="comma separated SPI clocks to re-time the stream, e.g. 4e6,8e6,16e6")
+    ap.add_argument("--txn-overhead-us", type=float, default=2.0, help="CS/DC handling per transaction for re-timing")
+    ap.add_argument("--dump", action="store_true", help="print all transactions of each frame")
+    ap.add_argument("--pbm", metavar="DIR", help="write the display content after each frame as DIR/frame_<n>.pbm")
+    ap.add_argument("--msb-top", action="store_true", help="for --pbm: bit 7 of a column byte is the top pixel")
+    ap.add_argument("--y-offset", type=int, default=0, help="for --pbm: first RAM row shown by the display")
+    args = ap.parse_args()
+
+    spi_hz, dropped, events = parse(load(args.trace, args.serial))
+    frames = split_frames(events)
+    clocks = [float(v) for v in args.spi_hz.split(",") if v] or [spi_hz]
+
+    print("recorded SPI clock %d Hz, %d records dropped, %d events, %d frames" % (spi_hz, dropped, len(events), len(frames)))
+    panels = max([txn["panel"] for frame in frames for txn in frame.transactions] + [0]) + 1
+    print("%5s %7s %6s %6s %5s %6s %9s %s %s" % ("frame", "bytes", "cmd", "data", "txn", "repeat", "rec. us", " ".join("%9s" % ("@%gMHz" % (hz / 1e6)) for hz in clocks),
+                                            " ".join("%7s" % ("p%d" % p) for p in range(panels)) if panels > 1 else ""))
+
+    repeated_total = collections.Counter()
+    panel_total = collections.defaultdict(lambda: [0, 0])
+    for n, frame in enumerate(frames):
+        cmd, data, repeated = frame_stats(frame)
+        recorded = frame.end_us - frame.start_us
+        times = " ".join("%9.0f" % bus_time_us(frame, hz, args.txn_overhead_us) for hz in clocks)
+        per_panel = panel_stats(frame)
+        for p, (txns, nbytes) in per_panel.items():
+            panel_total[p][0] += txns
+            panel_total[p][1] += nbytes
+        panel_bytes = " ".join("%7d" % per_panel[p][1] for p in range(panels)) if panels > 1 else ""
+        print("%5d %7d %6d %6d %5d %6d %9d %s %s" % (n, cmd + data, cmd, data, len(frame.transactions), repeated, recorded, times, panel_bytes))
+
+        seen = set()
+        for txn in frame.transactions:
+            for dc, payload in txn["parts"]:
+                if dc == 0:
+                    if payload in seen:
+                        repeated_total[payload] += 1
+                    seen.add(payload)
+
+        if args.dump:
+            for txn in frame.transactions:
+                print("    +%6d us p%d: %s" % (txn["start"] - frame.start_us, txn["panel"], " | ".join(("C " if dc == 0 else "D ") + payload.hex() for dc, payload in txn["parts"])))
+
+    if panels > 1:
+        print("\n%5s %7s %9s" % ("panel", "txn", "bytes"))
+        for p in range(panels):
+            print("%5d %7d %9d" % (p, panel_total[p][0], panel_total[p][1]))
+
+    if args.pbm:
+        writes = write_pbm(frames, args.pbm, args.msb_top, args.y_offset)
+        print("\n%d images in %s, %d RAM writes" % (len(frames), args.pbm, sum(writes)))
+
+    if repeated_total:
+        print("\nCommand sequences sent more than once within a frame:")
+        for payload, count in repeated_total.most_common(10):
+            print("  %6d x  %s" % (count, payload.hex()))
+
+
+if __name__ == "__main__":
+    main()